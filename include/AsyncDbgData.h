@@ -0,0 +1,108 @@
+#ifndef _ASYNC_DBG_DATA_H_
+#define _ASYNC_DBG_DATA_H_
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include "SymbolDescriptor.h"
+
+namespace CdbgExpr
+{
+    // Awaitable for one target operation, started when it is awaited.
+    class AsyncOperation
+    {
+    public:
+        using Completion = std::function<void(std::exception_ptr)>;
+
+        explicit AsyncOperation(std::function<void(Completion)> start) : start(std::move(start)) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const;
+
+    private:
+        std::function<void(Completion)> start;
+        std::coroutine_handle<> waiter;
+        std::exception_ptr error;
+        bool finished = false;
+        bool suspended = false;
+    };
+
+    // Target access that does not block. Each operation is started with a
+    // completion that is called, with the error if there was one, once the data
+    // is there; requests may complete in any order, also before the call
+    // returns. Completions are expected on the thread that runs the evaluation.
+    // Symbols and types come from the host side and stay synchronous.
+    class AsyncDbgData
+    {
+    public:
+        using Completion = AsyncOperation::Completion;
+
+        virtual ~AsyncDbgData() = default;
+
+        virtual SymbolDescriptor getSymbol(const std::string &) = 0;
+        virtual uint8_t CTypeSize(CType) = 0;
+        virtual bool isTypeName(const std::string &) { return false; }
+        virtual std::shared_ptr<const StructLayout> getLayout(const std::string &) { return nullptr; }
+        virtual uint8_t registerCount() { return 8; }
+        // Layout of the target if there is a synchronous one behind, evaluators
+        // share it instead of resolving sizes on their own.
+        virtual TargetModel *targetModel() { return nullptr; }
+
+        virtual void readBlockAsync(uint64_t addr, std::span<uint8_t> out, Completion done) = 0;
+        virtual void writeBlockAsync(uint64_t addr, std::span<const uint8_t> in, Completion done) = 0;
+        virtual void getStackPointerAsync(uint64_t &sp, Completion done) = 0;
+        virtual void getRegistersAsync(std::span<uint8_t> out, Completion done) = 0;
+        virtual void setRegistersAsync(std::span<const uint8_t> regNums, std::span<const uint8_t> vals, Completion done) = 0;
+        // Access to a specific address space, by default the space is ignored.
+        virtual void readMemoryAsync(AddressSpace space, uint64_t addr, std::span<uint8_t> out, Completion done);
+        virtual void writeMemoryAsync(AddressSpace space, uint64_t addr, std::span<const uint8_t> in, Completion done);
+
+        // Awaitable forms of the operations above.
+        AsyncOperation readBlock(uint64_t addr, std::span<uint8_t> out);
+        AsyncOperation writeBlock(uint64_t addr, std::span<const uint8_t> in);
+        AsyncOperation readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out);
+        AsyncOperation writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in);
+        AsyncOperation getStackPointer(uint64_t &sp);
+        AsyncOperation getRegisters(std::span<uint8_t> out);
+        AsyncOperation setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals);
+
+        uint64_t invalidAddress = 0; // non-valid memory address (eg. nullptr/0)
+        ByteOrder byteOrder = ByteOrder::LITTLE;
+    };
+
+    // Presents a synchronous DbgData as an AsyncDbgData, every operation
+    // completes before it returns.
+    class SyncDbgDataAdapter : public AsyncDbgData
+    {
+    public:
+        explicit SyncDbgDataAdapter(DbgData *target);
+
+        SymbolDescriptor getSymbol(const std::string &name) override;
+        uint8_t CTypeSize(CType type) override;
+        bool isTypeName(const std::string &name) override;
+        std::shared_ptr<const StructLayout> getLayout(const std::string &name) override;
+        uint8_t registerCount() override;
+        TargetModel *targetModel() override { return &target_->model; }
+
+        void readBlockAsync(uint64_t addr, std::span<uint8_t> out, Completion done) override;
+        void writeBlockAsync(uint64_t addr, std::span<const uint8_t> in, Completion done) override;
+        void getStackPointerAsync(uint64_t &sp, Completion done) override;
+        void getRegistersAsync(std::span<uint8_t> out, Completion done) override;
+        void setRegistersAsync(std::span<const uint8_t> regNums, std::span<const uint8_t> vals, Completion done) override;
+        void readMemoryAsync(AddressSpace space, uint64_t addr, std::span<uint8_t> out, Completion done) override;
+        void writeMemoryAsync(AddressSpace space, uint64_t addr, std::span<const uint8_t> in, Completion done) override;
+
+        DbgData *target() const { return target_; }
+
+    private:
+        DbgData *target_;
+    };
+
+} // namespace CdbgExpr
+
+#endif // _ASYNC_DBG_DATA_H_
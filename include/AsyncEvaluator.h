@@ -0,0 +1,176 @@
+#ifndef _ASYNC_EVALUATOR_H_
+#define _ASYNC_EVALUATOR_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "AsyncDbgData.h"
+#include "CdbgExpr.h"
+#include "Task.h"
+
+namespace CdbgExpr
+{
+    // Thrown by AsyncEvaluator when evaluation needs target state that has not
+    // been fetched yet.
+    class MissingData : public std::runtime_error
+    {
+    public:
+        enum class Kind
+        {
+            MEMORY,
+            REGISTERS,
+            STACK_POINTER
+        };
+
+        MissingData(Kind kind, uint64_t addr = 0, uint64_t size = 0, AddressSpace space = AddressSpace::UNDEFINED)
+            : std::runtime_error("Target data has not been fetched"), kind(kind), addr(addr), size(size), space(space) {}
+
+        Kind kind;
+        uint64_t addr;
+        uint64_t size; // bytes for memory, registers for REGISTERS
+        AddressSpace space;
+    };
+
+    // Evaluates compiled expressions against an AsyncDbgData. The evaluator is
+    // itself the DbgData the expressions are compiled against: it serves target
+    // state fetched during the current stop and throws MissingData for anything
+    // else. Evaluation first walks the tree fetching what each node needs, with
+    // independent subtrees (and sibling expressions) in flight together, then
+    // runs the regular evaluator over the fetched state, fetching and retrying
+    // on the rare miss. Writes are sent to the target when an evaluation ends,
+    // and what displaying the result needs is fetched along with it. SFRs are
+    // fetched again for every evaluation.
+    // The evaluator must outlive the operations it starts.
+    class AsyncEvaluator : public DbgData
+    {
+    public:
+        static constexpr size_t PAGE_SIZE = 64;
+
+        explicit AsyncEvaluator(AsyncDbgData *target);
+
+        SymbolDescriptor getSymbol(const std::string &name) override;
+        uint8_t getByte(uint64_t addr) override;
+        void setByte(uint64_t addr, uint8_t val) override;
+        void readBlock(uint64_t addr, std::span<uint8_t> out) override;
+        void writeBlock(uint64_t addr, std::span<const uint8_t> in) override;
+        void readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out) override;
+        void writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in) override;
+        uint8_t CTypeSize(CType type) override;
+        uint64_t getStackPointer() override;
+        uint8_t getRegContent(uint8_t regNum) override;
+        void setRegContent(uint8_t regNum, uint8_t val) override;
+        uint8_t registerCount() override;
+        void getRegisters(std::span<uint8_t> out) override;
+        void setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals) override;
+        bool isTypeName(const std::string &name) override;
+        std::shared_ptr<const StructLayout> getLayout(const std::string &name) override;
+
+        // Fetches what the expression reads, without side effects on the target.
+        // Assignments are only followed if allowed, their writes are discarded.
+        Task<void> prepare(const CompiledExpression &expr, bool assignmentAllowed = false);
+        // Prepares several expressions concurrently, eg. a watch list.
+        Task<void> prepareAll(std::vector<const CompiledExpression *> exprs);
+        Task<SymbolDescriptor> eval(const CompiledExpression &expr, bool assignmentAllowed);
+        // Sends writes made outside of eval(), eg. by a synchronous evaluation.
+        Task<void> writeBack();
+
+        // Runs one evaluation step of a node (its operation applied to the values
+        // of its operands) over the fetched state, fetching until nothing is
+        // missing. Returns the value, or nothing if evaluation failed; writes are
+        // discarded. Used by ASTNode::fetchAsync, once per node.
+        Task<std::optional<SymbolDescriptor>> settle(std::function<SymbolDescriptor()> step, bool assignmentAllowed);
+
+        // Drops the fetched state, call when the target resumes.
+        void invalidate();
+
+        AsyncDbgData *target() const { return target_; }
+
+    private:
+        struct Fetch
+        {
+            bool done = false;
+            std::exception_ptr error;
+            std::vector<std::coroutine_handle<>> waiters;
+            std::vector<uint8_t> buffer;
+            uint64_t value = 0;
+            uint64_t epoch = 0;
+        };
+
+        // Holds a plain pointer, the awaiting coroutine keeps the fetch alive.
+        struct FetchAwaiter
+        {
+            Fetch *fetch;
+
+            bool await_ready() const noexcept { return fetch->done; }
+            void await_suspend(std::coroutine_handle<> handle) { fetch->waiters.push_back(handle); }
+            void await_resume() const
+            {
+                if (fetch->error)
+                {
+                    std::rethrow_exception(fetch->error);
+                }
+            }
+        };
+
+        // One evaluation over the fetched state. Register writes are held until
+        // commit(), the statics point back to the evaluator afterwards.
+        class Attempt
+        {
+        public:
+            Attempt(AsyncEvaluator &evaluator, DbgData &staged, bool assignmentAllowed);
+            ~Attempt();
+            void commit();
+
+        private:
+            AsyncEvaluator &evaluator;
+            size_t writeMark; // memory writes queued before the attempt
+            bool previousAssignmentAllowed;
+            bool committed = false;
+        };
+
+        using PageKey = std::pair<AddressSpace, uint64_t>; // space, page number
+
+        struct PendingWrite
+        {
+            AddressSpace space;
+            uint64_t addr;
+            std::vector<uint8_t> bytes;
+        };
+
+        static constexpr int MAX_ATTEMPTS = 64;
+
+        AsyncDbgData *target_;
+        uint64_t epoch = 0;
+
+        std::map<PageKey, std::vector<uint8_t>> pages;
+        std::map<PageKey, std::shared_ptr<Fetch>> inflight;
+        std::vector<uint8_t> regs;
+        std::shared_ptr<Fetch> regFetch;
+        std::optional<uint64_t> sp;
+        std::shared_ptr<Fetch> spFetch;
+
+        std::vector<std::pair<uint8_t, uint8_t>> regWrites; // of the running attempt
+        std::vector<PendingWrite> pendingWrites;
+        std::vector<uint8_t> pendingRegNums, pendingRegVals;
+
+        static bool isVolatile(AddressSpace space);
+        static void complete(Fetch &fetch);
+        void dropVolatile();
+        Task<void> fetch(MissingData missing);
+        Task<void> fetchRanges(std::span<const AddressRange> ranges);
+        Task<void> fetchRegisters(size_t count);
+        Task<void> fetchStackPointer();
+        Task<void> prefetchReadSet(const CompiledExpression &expr);
+        // Fetches what toString() of the value reads (array contents, strings).
+        Task<void> fetchForDisplay(const SymbolDescriptor &value);
+    };
+
+} // namespace CdbgExpr
+
+#endif // _ASYNC_EVALUATOR_H_
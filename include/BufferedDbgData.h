@@ -0,0 +1,85 @@
+#ifndef _BUFFERED_DBG_DATA_H_
+#define _BUFFERED_DBG_DATA_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <vector>
+#include "SymbolDescriptor.h"
+
+namespace CdbgExpr
+{
+    // Write buffer around another DbgData. Memory writes are held back and
+    // merged into contiguous ranges per address space, flush() sends each range
+    // with a single write. Reads see the pending writes. Register writes and
+    // writes to SFRs, which have side effects on the target, are not buffered.
+    class BufferedDbgData : public DbgData
+    {
+    public:
+        explicit BufferedDbgData(DbgData *target);
+
+        SymbolDescriptor getSymbol(const std::string &name) override;
+        uint8_t getByte(uint64_t addr) override;
+        void setByte(uint64_t addr, uint8_t val) override;
+        void readBlock(uint64_t addr, std::span<uint8_t> out) override;
+        void writeBlock(uint64_t addr, std::span<const uint8_t> in) override;
+        void readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out) override;
+        void writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in) override;
+        uint8_t CTypeSize(CType type) override;
+        uint64_t getStackPointer() override;
+        uint8_t getRegContent(uint8_t regNum) override;
+        void setRegContent(uint8_t regNum, uint8_t val) override;
+        uint8_t registerCount() override;
+        void getRegisters(std::span<uint8_t> out) override;
+        void setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals) override;
+        bool isTypeName(const std::string &name) override;
+        std::shared_ptr<const StructLayout> getLayout(const std::string &name) override;
+        void prefetch(std::span<const AddressRange> ranges) override;
+        // Also starts one on the target, the frame is taken from there.
+        void beginEvaluation() override;
+
+        // Writes all pending ranges to the target.
+        void flush();
+        // Drops all pending writes.
+        void discard();
+
+        size_t pendingRanges() const;
+        size_t pendingBytes() const;
+        uint64_t flushedRanges() const { return flushCount; }
+
+        DbgData *target() const { return target_; }
+
+    protected:
+        FrameContext captureFrame() override;
+
+    private:
+        using Ranges = std::map<uint64_t, std::vector<uint8_t>>; // start address -> bytes
+
+        DbgData *target_;
+        std::map<AddressSpace, Ranges> pending;
+        uint64_t flushCount = 0;
+    };
+
+    // Buffers the writes of one evaluation or batch of evaluations. commit()
+    // flushes them; if the batch is left without commit (an exception was
+    // thrown part-way) the pending writes are discarded or flushed, as chosen.
+    class WriteBatch
+    {
+    public:
+        explicit WriteBatch(BufferedDbgData &buffer, bool discardOnError = false);
+        ~WriteBatch();
+
+        WriteBatch(const WriteBatch &) = delete;
+        WriteBatch &operator=(const WriteBatch &) = delete;
+
+        void commit();
+
+    private:
+        BufferedDbgData &buffer;
+        bool discardOnError;
+        bool committed = false;
+    };
+
+} // namespace CdbgExpr
+
+#endif // _BUFFERED_DBG_DATA_H_
@@ -0,0 +1,75 @@
+#ifndef _BYTECODE_H_
+#define _BYTECODE_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "SymbolDescriptor.h"
+
+namespace CdbgExpr
+{
+    enum class Opcode : uint8_t;
+
+    enum class BytecodeOp : uint8_t
+    {
+        PUSH_CONST,  // push constants[arg]
+        LOAD_SYMBOL, // push the symbol names[arg]
+        DEREF,       // top = *top
+        ADDRESS_OF,  // top = &top
+        MEMBER,      // top = top.names[arg]
+        PTR_MEMBER,  // top = top->names[arg]
+        INDEX,       // pop index, top = top[index]
+        UNARY,       // top = op top
+        BINARY,      // pop right, top = top op right
+        CAST,        // top = (castTypes[arg])top
+        PROMOTE,     // top = top op constants[arg], for an identity op
+        PROMOTE_LEFT, // top = constants[arg] op top, for an identity op
+        TO_BOOL,      // top = top != 0
+        POP,          // drop top
+        JUMP,         // continue at arg
+        JUMP_IF_FALSE, // continue at arg if top is false, keeps top
+        JUMP_IF_TRUE,  // continue at arg if top is true, keeps top
+        BRANCH_IF_FALSE // pop, continue at arg if it was false
+    };
+
+    struct Instruction
+    {
+        BytecodeOp code;
+        Opcode op;
+        uint16_t arg;
+    };
+
+    // Flat, linear form of an expression AST, executed by a stack machine.
+    class BytecodeProgram
+    {
+    public:
+        static constexpr size_t STACK_SIZE = 32;
+
+        std::vector<Instruction> code;
+        std::vector<SymbolDescriptor> constants;
+        std::vector<std::string> names;
+        std::vector<CastType> castTypes;
+
+        void emit(BytecodeOp code, Opcode op, uint16_t arg = 0);
+        // Index of the next instruction, for use as a jump target.
+        uint16_t label() const;
+        // Points the jump at 'at' to 'target'.
+        void patch(uint16_t at, uint16_t target);
+
+        // Static stack depth, restored by branches that join.
+        size_t stackDepth() const { return depth; }
+        void setStackDepth(size_t d) { depth = d; }
+        uint16_t addConstant(const SymbolDescriptor &value);
+        uint16_t addName(const std::string &name);
+        uint16_t addCastType(const CastType &type);
+
+        // Reentrant, the value stack is local to the run.
+        SymbolDescriptor run() const;
+
+    private:
+        size_t depth = 0;
+    };
+
+} // namespace CdbgExpr
+
+#endif // _BYTECODE_H_
@@ -0,0 +1,109 @@
+#ifndef _CACHED_DBG_DATA_H_
+#define _CACHED_DBG_DATA_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "SymbolDescriptor.h"
+
+namespace CdbgExpr
+{
+    // Caching layer around another DbgData. Target memory is kept in fixed size
+    // pages which are served from the cache until the epoch changes, the debugger
+    // bumps it whenever the target runs. Writes go through to the target and
+    // update the cached copy. How long pages are kept is chosen per address
+    // space: code for the whole session, SFRs not at all, anything else per stop.
+    class CachedDbgData : public DbgData
+    {
+    public:
+        static constexpr size_t DEFAULT_PAGE_SIZE = 64;
+
+        enum class Policy : uint8_t
+        {
+            NEVER,    // volatile, always read from the target
+            PER_STOP, // until the next invalidate()
+            SESSION   // until clear(), for memory the program cannot change
+        };
+
+        explicit CachedDbgData(DbgData *target, size_t pageSize = DEFAULT_PAGE_SIZE);
+
+        SymbolDescriptor getSymbol(const std::string &name) override;
+        uint8_t getByte(uint64_t addr) override;
+        void setByte(uint64_t addr, uint8_t val) override;
+        void readBlock(uint64_t addr, std::span<uint8_t> out) override;
+        void writeBlock(uint64_t addr, std::span<const uint8_t> in) override;
+        void readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out) override;
+        void writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in) override;
+        uint8_t CTypeSize(CType type) override;
+        uint64_t getStackPointer() override;
+        uint8_t getRegContent(uint8_t regNum) override;
+        void setRegContent(uint8_t regNum, uint8_t val) override;
+        uint8_t registerCount() override;
+        void getRegisters(std::span<uint8_t> out) override;
+        void setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals) override;
+        bool isTypeName(const std::string &name) override;
+        std::shared_ptr<const StructLayout> getLayout(const std::string &name) override;
+        // Fetches the missing pages of the ranges, one readBlock per run of
+        // consecutive missing pages.
+        void prefetch(std::span<const AddressRange> ranges) override;
+
+        Policy policy(AddressSpace space) const { return policies[static_cast<uint8_t>(space)]; }
+        void setPolicy(AddressSpace space, Policy policy);
+
+        // Drops the pages cached per stop, the register snapshot and the frame
+        // context, call when the target resumes.
+        void invalidate();
+        // Invalidates the cache if stopEpoch differs from the current epoch.
+        void setEpoch(uint64_t stopEpoch);
+        // Drops every page, also those kept for the session (eg. after a reload).
+        void clear();
+        uint64_t epoch() const { return currentEpoch; }
+
+        size_t pageSize() const { return pageSize_; }
+        uint64_t hits() const { return hitCount; }
+        uint64_t misses() const { return missCount; }
+        void resetStats();
+
+        DbgData *target() const { return target_; }
+
+    private:
+        struct Page
+        {
+            uint64_t epoch;
+            std::vector<uint8_t> bytes;
+        };
+
+        struct PageKey
+        {
+            AddressSpace space;
+            uint64_t pageNum;
+
+            bool operator==(const PageKey &other) const { return space == other.space && pageNum == other.pageNum; }
+        };
+
+        struct PageKeyHash
+        {
+            size_t operator()(const PageKey &key) const
+            {
+                return std::hash<uint64_t>()(key.pageNum) ^ (static_cast<size_t>(key.space) << 1);
+            }
+        };
+
+        DbgData *target_;
+        size_t pageSize_;
+        uint64_t currentEpoch = 0;
+        uint64_t hitCount = 0;
+        uint64_t missCount = 0;
+        std::unordered_map<PageKey, Page, PageKeyHash> pages;
+        std::array<Policy, 256> policies;
+
+        bool isValid(const PageKey &key, const Page &page) const;
+        Page &fetch(const PageKey &key);
+    };
+
+} // namespace CdbgExpr
+
+#endif // _CACHED_DBG_DATA_H_
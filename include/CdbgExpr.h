@@ -2,11 +2,15 @@
 #define _CDBG_EXPR_H_
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <cctype>
 #include <functional>
 #include <memory>
+#include <deque>
+#include <optional>
+#include <cstddef>
 #include "SymbolDescriptor.h"
 
 namespace CdbgExpr
@@ -25,12 +29,100 @@ namespace CdbgExpr
         STRING_LITERAL
     };
 
+    enum class Opcode : uint8_t
+    {
+        NONE,
+        // arithmetic
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        MOD,
+        // bitwise
+        BIT_AND,
+        BIT_OR,
+        BIT_XOR,
+        BIT_NOT,
+        SHL,
+        SHR,
+        // logical
+        LOGICAL_AND,
+        LOGICAL_OR,
+        LOGICAL_NOT,
+        // comparison
+        EQ,
+        NE,
+        LT,
+        GT,
+        LE,
+        GE,
+        // assignment
+        ASSIGN,
+        ADD_ASSIGN,
+        SUB_ASSIGN,
+        MUL_ASSIGN,
+        DIV_ASSIGN,
+        MOD_ASSIGN,
+        AND_ASSIGN,
+        OR_ASSIGN,
+        XOR_ASSIGN,
+        SHL_ASSIGN,
+        SHR_ASSIGN,
+        // access
+        MEMBER,
+        PTR_MEMBER,
+        INDEX,
+        // misc
+        CONDITIONAL,
+        COLON,
+        COMMA,
+        LPAREN,
+        RPAREN,
+        LBRACKET,
+        RBRACKET
+    };
+
     struct Token
     {
         TokenType type;
-        std::string value;
+        std::string_view value; // span of the source expression
+        Opcode op = Opcode::NONE;
+        int precedence = 0;
+        NumericLiteral literal; // decoded value of NUMBER tokens
     };
 
+    class ASTNode;
+    class ASTArena;
+    class CompiledExpression;
+    class BytecodeProgram;
+    class AsyncEvaluator;
+    template <typename T>
+    class Task;
+
+    // Single pass lexer, tokens refer to the source string, which must outlive them.
+    class Lexer
+    {
+    public:
+        explicit Lexer(std::string_view src);
+
+        // Reads the next token, returns false at the end of input. Throws on a
+        // number that is not a valid literal (out of range, malformed).
+        bool next(Token &token);
+
+    private:
+        std::string_view src;
+        size_t pos = 0;
+        bool hasPrev = false;
+        TokenType prevType = TokenType::OPERATOR;
+        Opcode prevOp = Opcode::NONE;
+
+        bool scanNumber(Token &token);
+        bool scanOperator(Token &token);
+        bool expectsOperand() const;
+    };
+
+    std::vector<Token> tokenize(std::string_view expr);
+
     class Expression
     {
     public:
@@ -41,48 +133,114 @@ namespace CdbgExpr
 
     private:
         std::string expr_;
-        uint64_t pos_;
         DbgData *dbgData;
-        std::vector<Token> tokens;
-
-        void tokenize(const std::string &expr);
+        std::unique_ptr<CompiledExpression> compiled;
     };
 
-    SymbolDescriptor evalUnaryOperator(const SymbolDescriptor &operand, const std::string &op);
-    SymbolDescriptor evalBinaryOperator(SymbolDescriptor &left, const SymbolDescriptor &right, const std::string &op);
-    SymbolDescriptor evalArithmeticOperator(const SymbolDescriptor &left, const SymbolDescriptor &right, const std::string &op);
+    const char *opcodeName(Opcode op);
+    // Operands are evaluation temporaries, a result passed through is moved out.
+    SymbolDescriptor evalUnaryOperator(SymbolDescriptor &operand, Opcode op);
+    SymbolDescriptor evalBinaryOperator(SymbolDescriptor &left, SymbolDescriptor &right, Opcode op);
+    SymbolDescriptor evalArithmeticOperator(const SymbolDescriptor &left, const SymbolDescriptor &right, Opcode op);
     SymbolDescriptor evalArrayAccess(const SymbolDescriptor &array, const SymbolDescriptor &index);
     SymbolDescriptor evalMemberAccess(const SymbolDescriptor &structOrPointer, const std::string &member, bool isPointerAccess);
+    bool isBaseTypeName(std::string_view name);
+    SymbolDescriptor evalCast(const SymbolDescriptor &original, const CastType &type);
+    SymbolDescriptor evalPromote(const SymbolDescriptor &operand, const SymbolDescriptor &other, bool constantOnLeft, Opcode op);
     int getPrecedence(const Token &token);
 
+    // Owns all nodes of one expression. Nodes are bump allocated from a few
+    // contiguous blocks and released together with the arena. Names are interned
+    // so nodes can refer to them instead of holding their own copies.
+    class ASTArena
+    {
+    public:
+        ASTArena() = default;
+        ~ASTArena();
+
+        ASTArena(const ASTArena &) = delete;
+        ASTArena &operator=(const ASTArena &) = delete;
+
+        template <typename T, typename... Args>
+        T *make(Args &&...args)
+        {
+            T *node = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            nodes.push_back(node);
+            return node;
+        }
+
+        const std::string &intern(std::string_view str);
+
+        size_t nodeCount() const { return nodes.size(); }
+
+    private:
+        static constexpr size_t BLOCK_SIZE = 2048;
+
+        struct Block
+        {
+            std::unique_ptr<std::byte[]> data;
+            size_t size;
+            size_t used;
+        };
+
+        std::vector<Block> blocks;
+        std::vector<ASTNode *> nodes;
+        std::deque<std::string> strings;
+
+        void *allocate(size_t size, size_t align);
+    };
+
     class ASTNode
     {
     public:
         virtual ~ASTNode() = default;
-        virtual SymbolDescriptor evaluate() = 0;
+        virtual SymbolDescriptor evaluate() const = 0;
+        virtual void compile(BytecodeProgram &program) const = 0;
+        // Optimizes the subtree, returns the node to use in place of this one.
+        virtual ASTNode *optimize(ASTArena &arena) { (void)arena; return this; }
+        // Value of the node if it is a compile time constant.
+        virtual const SymbolDescriptor *constant() const { return nullptr; }
+        // Location the node evaluates to, if it is known without reading target
+        // memory (globals, their members and constant indices into them).
+        virtual bool staticLocation(SymbolDescriptor &out) const { (void)out; return false; }
+        // Adds the memory ranges the subtree always reads that are known up front.
+        virtual void collectReads(std::vector<AddressRange> &reads) const { (void)reads; }
+        // Fetches the target state evaluation of the subtree needs, see AsyncEvaluator.
+        // Returns the value of the node, or nothing if it could not be evaluated.
+        virtual Task<std::optional<SymbolDescriptor>> fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const;
         static DbgData *data;
     };
 
     class BinaryOpNode : public ASTNode
     {
     public:
-        std::string op;
-        std::unique_ptr<ASTNode> left, right;
+        Opcode op;
+        ASTNode *left, *right;
 
-        BinaryOpNode(std::string op, std::unique_ptr<ASTNode> lhs, std::unique_ptr<ASTNode> rhs);
+        BinaryOpNode(Opcode op, ASTNode *lhs, ASTNode *rhs);
 
-        SymbolDescriptor evaluate() override;
+        SymbolDescriptor evaluate() const override;
+        void compile(BytecodeProgram &program) const override;
+        bool staticLocation(SymbolDescriptor &out) const override;
+        void collectReads(std::vector<AddressRange> &reads) const override;
+        Task<std::optional<SymbolDescriptor>> fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const override;
+        ASTNode *optimize(ASTArena &arena) override;
     };
 
     class UnaryOpNode : public ASTNode
     {
     public:
-        std::string op;
-        std::unique_ptr<ASTNode> operand;
+        Opcode op;
+        ASTNode *operand;
 
-        UnaryOpNode(std::string op, std::unique_ptr<ASTNode> operand);
+        UnaryOpNode(Opcode op, ASTNode *operand);
 
-        SymbolDescriptor evaluate() override;
+        SymbolDescriptor evaluate() const override;
+        void compile(BytecodeProgram &program) const override;
+        bool staticLocation(SymbolDescriptor &out) const override;
+        void collectReads(std::vector<AddressRange> &reads) const override;
+        Task<std::optional<SymbolDescriptor>> fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const override;
+        ASTNode *optimize(ASTArena &arena) override;
     };
 
     class LiteralNode : public ASTNode
@@ -92,28 +250,87 @@ namespace CdbgExpr
 
         explicit LiteralNode(SymbolDescriptor val);
 
-        SymbolDescriptor evaluate() override;
+        SymbolDescriptor evaluate() const override;
+        void compile(BytecodeProgram &program) const override;
+        const SymbolDescriptor *constant() const override { return &value; }
     };
 
     class SymbolNode : public ASTNode
     {
     public:
-        std::string name;
+        const std::string &name; // interned in the arena
 
-        SymbolNode(std::string name);
+        SymbolNode(const std::string &name);
 
-        SymbolDescriptor evaluate() override;
+        SymbolDescriptor evaluate() const override;
+        void compile(BytecodeProgram &program) const override;
+        bool staticLocation(SymbolDescriptor &out) const override;
+        void collectReads(std::vector<AddressRange> &reads) const override;
     };
 
     class CastNode : public ASTNode 
     {
     public:
-        std::string typeName;
-        std::unique_ptr<ASTNode> expression;
+        CastType type;
+        ASTNode *expression;
     
-        CastNode(const std::string& type, std::unique_ptr<ASTNode> expr);
+        CastNode(CastType type, ASTNode *expr);
     
-        SymbolDescriptor evaluate() override;
+        SymbolDescriptor evaluate() const override;
+        void compile(BytecodeProgram &program) const override;
+        void collectReads(std::vector<AddressRange> &reads) const override;
+        Task<std::optional<SymbolDescriptor>> fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const override;
+        ASTNode *optimize(ASTArena &arena) override;
+    };
+
+    // && and ||, the right operand is only evaluated when it decides the result.
+    class LogicalNode : public ASTNode
+    {
+    public:
+        Opcode op;
+        ASTNode *left, *right;
+
+        LogicalNode(Opcode op, ASTNode *lhs, ASTNode *rhs);
+
+        SymbolDescriptor evaluate() const override;
+        void compile(BytecodeProgram &program) const override;
+        void collectReads(std::vector<AddressRange> &reads) const override;
+        Task<std::optional<SymbolDescriptor>> fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const override;
+        ASTNode *optimize(ASTArena &arena) override;
+    };
+
+    // cond ? a : b, only the selected branch is evaluated.
+    class ConditionalNode : public ASTNode
+    {
+    public:
+        ASTNode *condition, *whenTrue, *whenFalse;
+
+        ConditionalNode(ASTNode *cond, ASTNode *lhs, ASTNode *rhs);
+
+        SymbolDescriptor evaluate() const override;
+        void compile(BytecodeProgram &program) const override;
+        void collectReads(std::vector<AddressRange> &reads) const override;
+        Task<std::optional<SymbolDescriptor>> fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const override;
+        ASTNode *optimize(ASTArena &arena) override;
+    };
+
+    // What is left of an identity operation (x + 0, x * 1, 0 | x ...) after
+    // simplification: the operand, promoted as the elided operation would.
+    class PromoteNode : public ASTNode
+    {
+    public:
+        ASTNode *operand;
+        SymbolDescriptor other; // the elided constant
+        bool constantOnLeft;
+        Opcode op;              // the elided operation
+
+        PromoteNode(ASTNode *operand, SymbolDescriptor other, bool constantOnLeft, Opcode op);
+
+        SymbolDescriptor evaluate() const override;
+        void compile(BytecodeProgram &program) const override;
+        void collectReads(std::vector<AddressRange> &reads) const override;
+        Task<std::optional<SymbolDescriptor>> fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const override;
+        ASTNode *optimize(ASTArena &arena) override;
     };
 
 
@@ -122,15 +339,56 @@ namespace CdbgExpr
         std::vector<Token> tokens;
         size_t index;
         DbgData *debuggerData;
+        ASTArena &arena;
 
+        bool isTypeName(std::string_view name) const;
+        bool isCastAhead() const;
         std::string parseCastType();
-        std::unique_ptr<ASTNode> parsePrimary();
-        std::unique_ptr<ASTNode> parseExpression(int minPrecedence);
+        ASTNode *parsePrimary();
+        ASTNode *parseExpression(int minPrecedence);
 
     public:
-        ExpressionParser(std::vector<Token> tokens, DbgData *debuggerData);
+        ExpressionParser(std::vector<Token> tokens, DbgData *debuggerData, ASTArena &arena);
+
+        // The returned tree is owned by the arena.
+        ASTNode *parse();
+    };
+
+    // An expression that has been tokenized and parsed once. The AST is never
+    // modified afterwards, so the same handle can be evaluated any number of
+    // times against the current target state.
+    class CompiledExpression
+    {
+    public:
+        enum class Backend
+        {
+            AST,     // walk the tree
+            BYTECODE // run the flattened program on the stack machine
+        };
+
+        CompiledExpression(const std::string &expr, DbgData *dbgData, Backend backend = Backend::BYTECODE);
+        ~CompiledExpression();
 
-        std::unique_ptr<ASTNode> parse();
+        CompiledExpression(const CompiledExpression &) = delete;
+        CompiledExpression &operator=(const CompiledExpression &) = delete;
+
+        SymbolDescriptor eval(bool assignmentAllowed) const;
+
+        const std::string &source() const { return expr_; }
+        Backend backend() const { return backend_; }
+        // Memory every evaluation reads that is known up front, coalesced. Built
+        // for the current scope and prefetched before each evaluation.
+        std::vector<AddressRange> readSet() const;
+
+    private:
+        friend class AsyncEvaluator;
+
+        std::string expr_;
+        DbgData *dbgData;
+        Backend backend_;
+        ASTArena arena;
+        const ASTNode *root = nullptr;
+        std::unique_ptr<BytecodeProgram> program;
     };
 
 } // namespace CdbgExpr
@@ -0,0 +1,109 @@
+#ifndef _SIMULATED_TARGET_H_
+#define _SIMULATED_TARGET_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include "SymbolDescriptor.h"
+
+namespace CdbgExpr
+{
+    // In-memory 8051 style target for measuring the evaluator without hardware.
+    // Every call into it is one transaction over a simulated probe link, charged
+    // a fixed latency plus a cost per byte moved; the counters tell how many
+    // round trips an evaluation took. The time is accounted for and, if
+    // realTime is set, also spent sleeping.
+    //
+    // Memory is kept per space: 64k of code, 64k of xdata, 256 bytes of idata
+    // and the SFRs at 0x80 - 0xFF. R0 - R7 are in idata at the bank selected by
+    // PSW and the stack pointer is the SP SFR, as on the real part. The flat
+    // accessors (readBlock, getByte, ...) address xdata.
+    class SimulatedTarget : public DbgData
+    {
+    public:
+        static constexpr uint8_t SFR_SP = 0x81;
+        static constexpr uint8_t SFR_PSW = 0xD0;
+
+        struct Latency
+        {
+            std::chrono::nanoseconds perCall{0};
+            std::chrono::nanoseconds perByte{0};
+        };
+
+        struct Stats
+        {
+            uint64_t transactions = 0;
+            uint64_t readCalls = 0;
+            uint64_t writeCalls = 0;
+            uint64_t registerCalls = 0;
+            uint64_t stackPointerCalls = 0;
+            uint64_t bytesRead = 0;
+            uint64_t bytesWritten = 0;
+            std::chrono::nanoseconds elapsed{0}; // simulated link time
+        };
+
+        SimulatedTarget() = default;
+        explicit SimulatedTarget(Latency latency, bool realTime = false) : latency(latency), realTime(realTime) {}
+
+        SymbolDescriptor getSymbol(const std::string &name) override;
+        uint8_t getByte(uint64_t addr) override;
+        void setByte(uint64_t addr, uint8_t val) override;
+        void readBlock(uint64_t addr, std::span<uint8_t> out) override;
+        void writeBlock(uint64_t addr, std::span<const uint8_t> in) override;
+        void readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out) override;
+        void writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in) override;
+        uint8_t CTypeSize(CType type) override;
+        uint64_t getStackPointer() override;
+        uint8_t getRegContent(uint8_t regNum) override;
+        void setRegContent(uint8_t regNum, uint8_t val) override;
+        void getRegisters(std::span<uint8_t> out) override;
+        void setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals) override;
+        bool isTypeName(const std::string &name) override;
+        std::shared_ptr<const StructLayout> getLayout(const std::string &name) override;
+
+        // Symbol table and types, set up by the harness.
+        void addSymbol(const SymbolDescriptor &symbol);
+        // Registers a struct, union or typedef name; size and layout are used for
+        // struct and union types of that name.
+        void addType(const std::string &name, uint8_t size = 0, std::shared_ptr<const StructLayout> layout = nullptr);
+
+        // Direct access to target state, not counted as transactions.
+        void load(AddressSpace space, uint64_t addr, std::span<const uint8_t> in);
+        void dump(AddressSpace space, uint64_t addr, std::span<uint8_t> out);
+        void setStackPointer(uint8_t sp) { sfr[SFR_SP - 0x80] = sp; }
+        void setRegisterBank(uint8_t bank);
+
+        const Stats &stats() const { return stats_; }
+        void resetStats() { stats_ = Stats(); }
+
+        Latency latency;
+        bool realTime = false;
+
+    private:
+        std::array<uint8_t, 0x10000> code{};
+        std::array<uint8_t, 0x10000> xdata{};
+        std::array<uint8_t, 0x100> idata{};
+        std::array<uint8_t, 0x80> sfr{};
+        std::map<std::string, SymbolDescriptor> symbols;
+        std::map<std::string, uint8_t> types;
+        std::map<std::string, std::shared_ptr<const StructLayout>> layouts;
+        Stats stats_;
+
+        // Charges one transaction moving the given number of bytes.
+        void transaction(size_t bytes);
+        // Byte holding addr in space, for SBIT the byte holding the bit.
+        uint8_t &cell(AddressSpace space, uint64_t addr);
+        // One unit of the space: a byte, or 0 / 1 for SBIT.
+        uint8_t readSpace(AddressSpace space, uint64_t addr);
+        void writeSpace(AddressSpace space, uint64_t addr, uint8_t val);
+        uint8_t registerAddress(uint8_t regNum) const;
+    };
+
+} // namespace CdbgExpr
+
+#endif // _SIMULATED_TARGET_H_
@@ -2,10 +2,16 @@
 #define _SYMBOL_DESCRIPTOR_H_
 
 #include <string>
+#include <string_view>
+#include <initializer_list>
 #include <vector>
+#include <span>
+#include <array>
 #include <cstdint>
 #include <variant>
 #include <unordered_map>
+#include <memory>
+#include <type_traits>
 
 namespace CdbgExpr
 {
@@ -24,6 +30,33 @@ namespace CdbgExpr
         std::string name;
     };
 
+    // Memory spaces of the 8051 family, with the codes the CDB file uses for them
+    // (SDCC CDB file format, 2.3.2). UNDEFINED stands for the single flat space
+    // of targets that do not tell them apart.
+    enum class AddressSpace : char
+    {
+        EXTERNAL_STACK = 'A', // also pdata
+        INTERNAL_STACK = 'B',
+        CODE = 'C',
+        CODE_STATIC = 'D',
+        INTERNAL_RAM_LOW = 'E', // lower 128 bytes
+        EXTERNAL_RAM = 'F',
+        INTERNAL_RAM = 'G',
+        BIT_ADDRESSABLE = 'H',
+        SFR = 'I',
+        SBIT = 'J',
+        REGISTER = 'R',
+        UNDEFINED = 'Z'
+    };
+
+    // Space for a CDB address space code, UNDEFINED for unknown codes.
+    AddressSpace addressSpaceFromCode(char code);
+    // Space a pointer declarator of a CDB type chain (DC, DX, DD, DI, DP, DG)
+    // points into. Generic pointers (DG) give UNDEFINED, their space is in the value.
+    AddressSpace pointerSpaceFromCode(std::string_view declarator);
+
+    class StructLayout;
+
     class CType
     {
     public:
@@ -50,6 +83,8 @@ namespace CdbgExpr
         char offset = 0;
         size_t size = 0;
         std::string name;
+        AddressSpace space = AddressSpace::UNDEFINED; // for POINTER, the space pointed into
+        std::shared_ptr<const StructLayout> layout;     // for STRUCT and UNION, if known
 
         CType() : type(Type::UNKNOWN) {}
         CType(CType::Type _type) : type(_type) {}
@@ -75,7 +110,151 @@ namespace CdbgExpr
         static std::vector<CType> parseCTypeVector(const std::string& typeStr, bool& isUnsigned);
     };
 
+    struct TypeNode;
+    class DbgData;
+
+    // Handle to an interned chain of C types, outermost layer first (POINTER, INT
+    // for int *). Each distinct chain is stored once in a session wide table, so
+    // handles are cheap to copy and compare, and stripping or adding a layer is
+    // a lookup. Reads like a const std::vector<CType>.
+    class TypeRef
+    {
+    public:
+        TypeRef() = default;
+        TypeRef(std::initializer_list<CType> types);
+        TypeRef(const std::vector<CType> &types);
+
+        // Chain of a single plain type, eg. the type of an arithmetic result.
+        static TypeRef of(CType::Type type);
+
+        size_t size() const;
+        bool empty() const { return node == nullptr; }
+        const CType &operator[](size_t level) const;
+        const CType &front() const { return (*this)[0]; }
+        const CType &back() const { return (*this)[size() - 1]; }
+        const CType *begin() const;
+        const CType *end() const;
+
+        bool operator==(const TypeRef &other) const { return node == other.node; }
+
+        // The chain without its outermost layer (pointee, element type).
+        TypeRef inner() const;
+        // Pointer into space to this chain.
+        TypeRef pointerTo(AddressSpace space) const;
+        // The chain with its outermost layer replaced.
+        TypeRef withOuter(const CType &type) const;
+
+        // Name as typeOf() prints it, built once per chain.
+        const std::string &name(bool isSigned) const;
+
+        // Size in bytes of a value of the chain, for an array the element count
+        // times the element size. Resolved through the model of data once and
+        // kept on the chain until the model is reset.
+        size_t byteSize(DbgData &data) const;
+        // Distance between the elements a pointer or array chain points to.
+        size_t stride(DbgData &data) const { return inner().byteSize(data); }
+
+    private:
+        explicit TypeRef(const TypeNode *node) : node(node) {}
+
+        const TypeNode *node = nullptr;
+    };
+
+    // Member of a struct or union, offset bytes from the start of the aggregate.
+    class Member
+    {
+    public:
+        std::string name;
+        uint64_t offset = 0;
+        TypeRef cType;
+        bool isSigned = false;
+    };
+
+    // Members of a struct or union type. Built once per type by the backend and
+    // shared by all values of the type; member values are made on access.
+    class StructLayout
+    {
+    public:
+        void add(Member member);
+        const Member *find(const std::string &name) const;
+        const std::vector<Member> &members() const { return members_; }
+
+    private:
+        std::vector<Member> members_; // in declaration order
+        std::unordered_map<std::string, size_t> index;
+    };
+
+    // Typed value of a numeric literal, decoded once by the lexer.
+    struct NumericLiteral
+    {
+        uint64_t value = 0; // integer value or IEEE bit pattern for FLOAT/DOUBLE
+        CType::Type type = CType::Type::INT;
+        bool isSigned = true;
+    };
+
     class SymbolDescriptor;
+    class DbgData;
+
+    enum class ByteOrder : uint8_t
+    {
+        LITTLE, // mcs51, z80, ...
+        BIG     // hc08, s08, stm8
+    };
+
+    // How values of one type are laid out in target memory: the size of the
+    // type, and fixed width kernels moving the first min(size, 8) bytes.
+    struct ValueCodec
+    {
+        uint8_t size = 0;
+        uint8_t width = 0;
+        uint64_t (*decode)(const uint8_t *bytes) = nullptr;
+        void (*encode)(uint64_t val, uint8_t *bytes) = nullptr;
+
+        static ValueCodec select(uint8_t size, ByteOrder order);
+    };
+
+    // Byte order and scalar layout of the target, fixed for a session. The
+    // backend sets the byte order, sizes are taken from CTypeSize the first time
+    // a scalar or pointer type is used. Aggregates are resolved on every call.
+    class TargetModel
+    {
+    public:
+        TargetModel();
+
+        ByteOrder byteOrder = ByteOrder::LITTLE;
+
+        ValueCodec codec(DbgData &data, const CType &type);
+        // Forgets the resolved sizes, eg. when another program is loaded.
+        void reset();
+        // Sizes cached on types are valid for one generation, see TypeRef::byteSize.
+        uint64_t generation() const { return shared_ ? shared_->generation_ : generation_; }
+        // Uses the layout of target from now on, for wrappers that forward to it.
+        // Sizes resolved through either are shared, and so is the generation.
+        void share(TargetModel &target);
+
+    private:
+        uint64_t generation_;
+        TargetModel *shared_ = nullptr;
+        std::array<ValueCodec, static_cast<size_t>(CType::Type::UNKNOWN) + 1> scalars{};
+        std::array<ValueCodec, 256> pointers{}; // by the space pointed into
+    };
+
+    // Contiguous range of target memory.
+    struct AddressRange
+    {
+        uint64_t addr;
+        uint64_t size;
+        AddressSpace space = AddressSpace::UNDEFINED;
+    };
+
+    // Frame that stack relative symbols (SymbolDescriptor::stack) resolve
+    // against: they live at frameBase + stackOffs.
+    struct FrameContext
+    {
+        uint64_t stackPointer = 0;
+        uint64_t frameBase = 0;
+        unsigned level = 0; // 0 for the innermost frame, counting outwards
+    };
 
     class DbgData
     {
@@ -83,14 +262,117 @@ namespace CdbgExpr
         virtual SymbolDescriptor getSymbol(const std::string &) = 0;
         virtual uint8_t getByte(uint64_t) = 0;
         virtual void setByte(uint64_t, uint8_t) = 0;
+        // Bulk access, one transaction per call. The defaults fall back to the
+        // byte accessors, targets should override them when they can do better.
+        virtual void readBlock(uint64_t addr, std::span<uint8_t> out);
+        virtual void writeBlock(uint64_t addr, std::span<const uint8_t> in);
+        // Access to one address space. The defaults ignore the space and use the
+        // flat accessors, targets with separate spaces override them.
+        virtual void readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out);
+        virtual void writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in);
         virtual uint8_t CTypeSize(CType) = 0;
         virtual uint64_t getStackPointer() = 0;
         virtual uint8_t getRegContent(uint8_t regNum) = 0;
         virtual void setRegContent(uint8_t regNum, uint8_t val) = 0;
+        // Bulk register access. getRegisters fills registers 0 .. out.size() - 1,
+        // setRegisters writes vals[i] to regNums[i]. The defaults fall back to the
+        // single register accessors.
+        virtual uint8_t registerCount() { return 8; }
+        virtual void getRegisters(std::span<uint8_t> out);
+        virtual void setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals);
+        // Whether name is a struct, union or typedef name, used to tell casts from
+        // parenthesized expressions.
+        virtual bool isTypeName(const std::string &) { return false; }
+        // Layout of the struct or union of that name, for types that do not carry
+        // one (eg. from a cast).
+        virtual std::shared_ptr<const StructLayout> getLayout(const std::string &) { return nullptr; }
+        // Hint that the ranges are about to be read, called before an expression is
+        // evaluated. Backends that cache memory can fetch them in bulk.
+        virtual void prefetch(std::span<const AddressRange>) {}
         uint64_t invalidAddress = 0; // non-valid memory address (eg. nullptr/0)
+        TargetModel model;
+
+        // Size of the type, through the model.
+        uint8_t sizeOf(const CType &type) { return model.codec(*this, type).size; }
+
+        // Register snapshot, captured with one getRegisters call on first use. It
+        // lasts for one top level evaluation, or with keepSnapshots until
+        // invalidateRegisters() (on resume).
+        uint8_t readRegister(uint8_t regNum);
+        void writeRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals);
+        void invalidateRegisters() { regSnapshotValid = false; }
+
+        // Called when a top level evaluation starts, drops what was captured for
+        // the previous one unless snapshots are kept.
+        virtual void beginEvaluation();
+
+        // Frame context, captured with one getStackPointer call on first use (the
+        // innermost frame, based at the stack pointer). Like the register snapshot
+        // it lasts for one top level evaluation unless snapshots are kept. A frame
+        // chosen with selectFrame() stays selected until invalidateFrame().
+        const FrameContext &frame();
+        void selectFrame(const FrameContext &context);
+        void invalidateFrame() { frameValid = false; frameSelected = false; }
+
+    protected:
+        // Frame to use when none is selected, by default the innermost one.
+        virtual FrameContext captureFrame();
+
+        // Set by backends that invalidate on resume themselves, to share the
+        // snapshots between the evaluations of one stop.
+        bool keepSnapshots = false;
+
+    private:
+        std::array<uint8_t, 256> regSnapshot{};
+        uint16_t regSnapshotSize = 0;
+        bool regSnapshotValid = false;
+        FrameContext frameContext;
+        bool frameValid = false;
+        bool frameSelected = false;
     };
 
-    class Member;
+    // Target of a cast, resolved once when the expression is parsed.
+    struct CastType
+    {
+        enum class Conversion
+        {
+            POINTER,
+            INTEGER,
+            FLOAT,
+            DOUBLE,
+            BOOL
+        };
+
+        std::string name;
+        TypeRef cType;
+        bool isSigned = true;
+        Conversion conversion = Conversion::INTEGER;
+        uint8_t size = 0; // size of integer targets, 0 if unknown
+
+        // Throws for types that cannot be cast to.
+        static CastType resolve(const std::string &typeName, DbgData *data);
+    };
+
+    // Rvalue the operators compute on: the raw bits of the value (IEEE bit
+    // pattern for FLOAT/DOUBLE) with its type. Read from the target once and
+    // copied freely, unlike a SymbolDescriptor it owns no storage.
+    struct Value
+    {
+        uint64_t bits = 0;
+        TypeRef type;
+        bool isSigned = false;
+
+        // Outermost type, a default CType for an untyped value.
+        const CType &outer() const;
+
+        float toFloat() const;
+        double toDouble() const;
+        uint64_t toUnsigned() const;
+        int64_t toSigned() const;
+        bool toBool() const;
+    };
+
+    static_assert(std::is_trivially_copyable_v<Value>);
 
     class SymbolDescriptor
     {
@@ -101,9 +383,9 @@ namespace CdbgExpr
         std::string name;
         uint64_t value;
         bool hasAddress = false;
+        AddressSpace space = AddressSpace::UNDEFINED; // of the location
         uint64_t size = 0;
         bool isSigned = false;
-        std::unordered_map<std::string, Member> members;
 
         bool stack = false;
         int stackOffs = 0;
@@ -111,7 +393,7 @@ namespace CdbgExpr
         std::vector<uint8_t> regs;
 
         // C type information.
-        std::vector<CType> cType;
+        TypeRef cType;
 
         SymbolDescriptor() = default;
         SymbolDescriptor(const char* s);
@@ -119,6 +401,8 @@ namespace CdbgExpr
         SymbolDescriptor(double d);
         SymbolDescriptor(int64_t i);
         SymbolDescriptor(uint64_t u);
+        SymbolDescriptor(const NumericLiteral& lit);
+        explicit SymbolDescriptor(const Value& val);
 
         std::variant<uint64_t, int64_t, double, float> getRealValue(const std::vector<uint64_t>& offset = {}) const;
 
@@ -129,13 +413,17 @@ namespace CdbgExpr
         static float value_to_float_b(uint64_t val);
         static float value_to_float_n(uint64_t val, CType type, bool isSigned = false);
 
-        static size_t getItemSize(const std::vector<CType>& cType, uint8_t level = 0);
+        static size_t getItemSize(const TypeRef& cType, uint8_t level = 0);
         static CType promoteType(const CType &left, const CType &right);
 
+        static bool decodeLiteral(std::string_view str, NumericLiteral &lit);
+
         void fromString(const std::string &str);
+        void fromLiteral(const NumericLiteral &lit);
         void fromDouble(const double &val);
         void fromInt(const int64_t &val);
         void fromUint(const uint64_t &val);
+        void fromBool(bool val);
 
         
         friend std::ostream& operator<<(std::ostream& os, const SymbolDescriptor& obj)
@@ -152,6 +440,8 @@ namespace CdbgExpr
 
         void setValue(uint64_t val);
         uint64_t getValue() const;
+        // The value with its type, reading the target once.
+        Value rvalue() const;
         void setValueAt(uint64_t addr, uint64_t val, uint8_t level = 0);
         uint64_t getValueAt(uint64_t addr, uint8_t level = 0) const;
 
@@ -161,16 +451,24 @@ namespace CdbgExpr
         SymbolDescriptor assign(const SymbolDescriptor &right);
 
         SymbolDescriptor getConstLiteral(const std::vector<uint64_t>& offset) const;
+        // The scalar the toX() accessors convert, read once: this value or the
+        // element offset selects. Only copies the descriptor to index into it.
+        Value scalar(const std::vector<uint64_t>& offset = {}) const;
 
         float toFloat(const std::vector<uint64_t>& offset = {}) const;
         double toDouble(const std::vector<uint64_t>& offset = {}) const;
         uint64_t toUnsigned(const std::vector<uint64_t>& offset = {}) const;
         int64_t toSigned(const std::vector<uint64_t>& offset = {}) const;
+        bool toBool(const std::vector<uint64_t>& offset = {}) const;
 
-        template <typename Op> SymbolDescriptor applyArithmetic(const SymbolDescriptor &right, Op op) const;
-        template <typename Op> SymbolDescriptor applyComparison(const SymbolDescriptor &right, Op op) const;
-        template <typename Op> SymbolDescriptor applyLogical(const SymbolDescriptor &right, Op op) const;
-        template <typename Op> SymbolDescriptor applyBitwise(const SymbolDescriptor &right, Op op) const;
+        template <typename Op> static Value applyArithmetic(const Value &left, const Value &right, Op op);
+        template <typename Op> static Value applyComparison(const Value &left, const Value &right, Op op);
+        template <typename Op> static Value applyLogical(const Value &left, const Value &right, Op op);
+        template <typename Op> static Value applyBitwise(const Value &left, const Value &right, Op op);
+
+        // Result of an identity operation such as x + 0 or 0 | x: the kept operand
+        // with the type and signedness the arithmetic (or bitwise) operation would give.
+        SymbolDescriptor applyIdentity(const SymbolDescriptor &right, bool keepRight, bool bitwise) const;
         
         SymbolDescriptor operator+(const SymbolDescriptor &right) const;
         SymbolDescriptor operator-(const SymbolDescriptor &right) const;
@@ -195,13 +493,6 @@ namespace CdbgExpr
         SymbolDescriptor operator>>(const SymbolDescriptor &right) const;
     };
 
-    class Member
-    {
-    public:
-        SymbolDescriptor symbol;  // The symbol information for this member.
-        int offset = 0;           // Member-specific offset.
-    };
-
 } // namespace CdbgExpr
 
 #endif // _SYMBOL_DESCRIPTOR_H_
@@ -0,0 +1,206 @@
+#ifndef _TASK_H_
+#define _TASK_H_
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace CdbgExpr
+{
+    namespace detail
+    {
+        template <typename T>
+        struct TaskResult
+        {
+            std::optional<T> value;
+
+            void return_value(T val) { value.emplace(std::move(val)); }
+            T take() { return std::move(*value); }
+        };
+
+        template <>
+        struct TaskResult<void>
+        {
+            void return_void() {}
+            void take() {}
+        };
+    } // namespace detail
+
+    // Lazily started coroutine. Awaiting a task runs it and resumes the awaiting
+    // coroutine when it finishes; a top level task is run with start() and its
+    // result collected with result() once done().
+    template <typename T>
+    class Task
+    {
+    public:
+        struct promise_type : detail::TaskResult<T>
+        {
+            std::exception_ptr error;
+            std::coroutine_handle<> continuation;
+
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    std::coroutine_handle<> next = handle.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            FinalAwaiter final_suspend() noexcept { return {}; }
+
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+        Task(Task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle)
+                {
+                    handle.destroy();
+                }
+                handle = std::exchange(other.handle, {});
+            }
+            return *this;
+        }
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            if (handle)
+            {
+                handle.destroy();
+            }
+        }
+
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+        T await_resume() { return result(); }
+
+        // Runs a top level task until it first suspends.
+        void start()
+        {
+            if (handle && !started)
+            {
+                started = true;
+                handle.resume();
+            }
+        }
+        bool done() const { return handle && handle.done(); }
+        T result()
+        {
+            if (!done())
+            {
+                throw std::logic_error("Task has not finished");
+            }
+            if (handle.promise().error)
+            {
+                std::rethrow_exception(handle.promise().error);
+            }
+            return handle.promise().take();
+        }
+
+    private:
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+        std::coroutine_handle<promise_type> handle;
+        bool started = false;
+    };
+
+    namespace detail
+    {
+        struct Latch
+        {
+            size_t count;
+            std::coroutine_handle<> waiter;
+            std::exception_ptr error;
+
+            // Must be the last use of the latch by the caller, the waiter may destroy it.
+            void arrive()
+            {
+                if (--count == 0 && waiter)
+                {
+                    waiter.resume();
+                }
+            }
+        };
+
+        // Eagerly started coroutine that frees itself when it finishes.
+        struct Detached
+        {
+            struct promise_type
+            {
+                Detached get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+
+        inline Detached runInto(Task<void> &task, Latch &latch)
+        {
+            try
+            {
+                co_await task;
+            }
+            catch (...)
+            {
+                if (!latch.error)
+                {
+                    latch.error = std::current_exception();
+                }
+            }
+            latch.arrive();
+        }
+    } // namespace detail
+
+    // Runs the tasks concurrently and finishes when all of them have, the first
+    // error is rethrown.
+    inline Task<void> whenAll(std::vector<Task<void>> tasks)
+    {
+        detail::Latch latch{tasks.size() + 1, {}, nullptr};
+
+        struct Awaiter
+        {
+            std::vector<Task<void>> &tasks;
+            detail::Latch &latch;
+
+            bool await_ready() noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                latch.waiter = handle;
+                for (Task<void> &task : tasks)
+                {
+                    detail::runInto(task, latch);
+                }
+                // the extra count keeps tasks that finish right away from resuming us
+                return --latch.count != 0;
+            }
+            void await_resume() noexcept {}
+        };
+
+        co_await Awaiter{tasks, latch};
+        if (latch.error)
+        {
+            std::rethrow_exception(latch.error);
+        }
+    }
+
+} // namespace CdbgExpr
+
+#endif // _TASK_H_
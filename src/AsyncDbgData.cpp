@@ -0,0 +1,219 @@
+#include "AsyncDbgData.h"
+#include <stdexcept>
+
+namespace CdbgExpr
+{
+    bool AsyncOperation::await_suspend(std::coroutine_handle<> handle)
+    {
+        waiter = handle;
+        start([this](std::exception_ptr err)
+              {
+                  error = err;
+                  finished = true;
+                  if (suspended)
+                  {
+                      waiter.resume();
+                  } });
+        if (finished)
+        {
+            return false; // completed inline, carry on without suspending
+        }
+        suspended = true;
+        return true;
+    }
+
+    void AsyncOperation::await_resume() const
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    AsyncOperation AsyncDbgData::readBlock(uint64_t addr, std::span<uint8_t> out)
+    {
+        return AsyncOperation([this, addr, out](Completion done)
+                              { readBlockAsync(addr, out, std::move(done)); });
+    }
+
+    AsyncOperation AsyncDbgData::writeBlock(uint64_t addr, std::span<const uint8_t> in)
+    {
+        return AsyncOperation([this, addr, in](Completion done)
+                              { writeBlockAsync(addr, in, std::move(done)); });
+    }
+
+    AsyncOperation AsyncDbgData::readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out)
+    {
+        return AsyncOperation([this, space, addr, out](Completion done)
+                              { readMemoryAsync(space, addr, out, std::move(done)); });
+    }
+
+    AsyncOperation AsyncDbgData::writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in)
+    {
+        return AsyncOperation([this, space, addr, in](Completion done)
+                              { writeMemoryAsync(space, addr, in, std::move(done)); });
+    }
+
+    void AsyncDbgData::readMemoryAsync(AddressSpace, uint64_t addr, std::span<uint8_t> out, Completion done)
+    {
+        readBlockAsync(addr, out, std::move(done));
+    }
+
+    void AsyncDbgData::writeMemoryAsync(AddressSpace, uint64_t addr, std::span<const uint8_t> in, Completion done)
+    {
+        writeBlockAsync(addr, in, std::move(done));
+    }
+
+    AsyncOperation AsyncDbgData::getStackPointer(uint64_t &sp)
+    {
+        return AsyncOperation([this, &sp](Completion done)
+                              { getStackPointerAsync(sp, std::move(done)); });
+    }
+
+    AsyncOperation AsyncDbgData::getRegisters(std::span<uint8_t> out)
+    {
+        return AsyncOperation([this, out](Completion done)
+                              { getRegistersAsync(out, std::move(done)); });
+    }
+
+    AsyncOperation AsyncDbgData::setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals)
+    {
+        return AsyncOperation([this, regNums, vals](Completion done)
+                              { setRegistersAsync(regNums, vals, std::move(done)); });
+    }
+
+    SyncDbgDataAdapter::SyncDbgDataAdapter(DbgData *target)
+        : target_(target)
+    {
+        if (!target_)
+        {
+            throw std::invalid_argument("SyncDbgDataAdapter needs a target");
+        }
+        invalidAddress = target_->invalidAddress;
+        byteOrder = target_->model.byteOrder;
+    }
+
+    SymbolDescriptor SyncDbgDataAdapter::getSymbol(const std::string &name)
+    {
+        return target_->getSymbol(name);
+    }
+
+    uint8_t SyncDbgDataAdapter::CTypeSize(CType type)
+    {
+        return target_->CTypeSize(type);
+    }
+
+    bool SyncDbgDataAdapter::isTypeName(const std::string &name)
+    {
+        return target_->isTypeName(name);
+    }
+
+    std::shared_ptr<const StructLayout> SyncDbgDataAdapter::getLayout(const std::string &name)
+    {
+        return target_->getLayout(name);
+    }
+
+    uint8_t SyncDbgDataAdapter::registerCount()
+    {
+        return target_->registerCount();
+    }
+
+    void SyncDbgDataAdapter::readBlockAsync(uint64_t addr, std::span<uint8_t> out, Completion done)
+    {
+        try
+        {
+            target_->readBlock(addr, out);
+        }
+        catch (...)
+        {
+            done(std::current_exception());
+            return;
+        }
+        done(nullptr);
+    }
+
+    void SyncDbgDataAdapter::writeBlockAsync(uint64_t addr, std::span<const uint8_t> in, Completion done)
+    {
+        try
+        {
+            target_->writeBlock(addr, in);
+        }
+        catch (...)
+        {
+            done(std::current_exception());
+            return;
+        }
+        done(nullptr);
+    }
+
+    void SyncDbgDataAdapter::getStackPointerAsync(uint64_t &sp, Completion done)
+    {
+        try
+        {
+            sp = target_->getStackPointer();
+        }
+        catch (...)
+        {
+            done(std::current_exception());
+            return;
+        }
+        done(nullptr);
+    }
+
+    void SyncDbgDataAdapter::getRegistersAsync(std::span<uint8_t> out, Completion done)
+    {
+        try
+        {
+            target_->getRegisters(out);
+        }
+        catch (...)
+        {
+            done(std::current_exception());
+            return;
+        }
+        done(nullptr);
+    }
+
+    void SyncDbgDataAdapter::setRegistersAsync(std::span<const uint8_t> regNums, std::span<const uint8_t> vals, Completion done)
+    {
+        try
+        {
+            target_->setRegisters(regNums, vals);
+        }
+        catch (...)
+        {
+            done(std::current_exception());
+            return;
+        }
+        done(nullptr);
+    }
+
+    void SyncDbgDataAdapter::readMemoryAsync(AddressSpace space, uint64_t addr, std::span<uint8_t> out, Completion done)
+    {
+        try
+        {
+            target_->readMemory(space, addr, out);
+        }
+        catch (...)
+        {
+            done(std::current_exception());
+            return;
+        }
+        done(nullptr);
+    }
+
+    void SyncDbgDataAdapter::writeMemoryAsync(AddressSpace space, uint64_t addr, std::span<const uint8_t> in, Completion done)
+    {
+        try
+        {
+            target_->writeMemory(space, addr, in);
+        }
+        catch (...)
+        {
+            done(std::current_exception());
+            return;
+        }
+        done(nullptr);
+    }
+
+} // namespace CdbgExpr
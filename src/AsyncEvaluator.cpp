@@ -0,0 +1,689 @@
+#include "AsyncEvaluator.h"
+#include "BufferedDbgData.h"
+#include "Bytecode.h"
+#include <algorithm>
+#include <cstring>
+
+namespace CdbgExpr
+{
+    AsyncEvaluator::AsyncEvaluator(AsyncDbgData *target)
+        : target_(target)
+    {
+        if (!target_)
+        {
+            throw std::invalid_argument("AsyncEvaluator needs a target");
+        }
+        invalidAddress = target_->invalidAddress;
+        if (TargetModel *targetModel = target_->targetModel())
+        {
+            model.share(*targetModel);
+        }
+        else
+        {
+            model.byteOrder = target_->byteOrder;
+        }
+        keepSnapshots = true; // dropped by invalidate()
+    }
+
+    SymbolDescriptor AsyncEvaluator::getSymbol(const std::string &name)
+    {
+        return target_->getSymbol(name);
+    }
+
+    uint8_t AsyncEvaluator::getByte(uint64_t addr)
+    {
+        uint8_t val;
+        readBlock(addr, std::span<uint8_t>(&val, 1));
+        return val;
+    }
+
+    void AsyncEvaluator::setByte(uint64_t addr, uint8_t val)
+    {
+        writeBlock(addr, std::span<const uint8_t>(&val, 1));
+    }
+
+    void AsyncEvaluator::readBlock(uint64_t addr, std::span<uint8_t> out)
+    {
+        readMemory(AddressSpace::UNDEFINED, addr, out);
+    }
+
+    void AsyncEvaluator::writeBlock(uint64_t addr, std::span<const uint8_t> in)
+    {
+        writeMemory(AddressSpace::UNDEFINED, addr, in);
+    }
+
+    void AsyncEvaluator::readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out)
+    {
+        size_t done = 0;
+        while (done < out.size())
+        {
+            uint64_t pageNum = (addr + done) / PAGE_SIZE;
+            size_t offset = (addr + done) % PAGE_SIZE;
+            size_t count = std::min(PAGE_SIZE - offset, out.size() - done);
+            auto it = pages.find({space, pageNum});
+            if (it == pages.end())
+            {
+                throw MissingData(MissingData::Kind::MEMORY, addr, out.size(), space);
+            }
+            std::memcpy(out.data() + done, it->second.data() + offset, count);
+            done += count;
+        }
+    }
+
+    void AsyncEvaluator::writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in)
+    {
+        size_t done = 0;
+        // what a SFR reads back after a write is up to the hardware
+        while (!isVolatile(space) && done < in.size())
+        {
+            uint64_t pageNum = (addr + done) / PAGE_SIZE;
+            size_t offset = (addr + done) % PAGE_SIZE;
+            size_t count = std::min(PAGE_SIZE - offset, in.size() - done);
+            auto it = pages.find({space, pageNum});
+            if (it != pages.end())
+            {
+                std::memcpy(it->second.data() + offset, in.data() + done, count);
+            }
+            done += count;
+        }
+        pendingWrites.push_back({space, addr, std::vector<uint8_t>(in.begin(), in.end())});
+    }
+
+    uint8_t AsyncEvaluator::CTypeSize(CType type)
+    {
+        return target_->CTypeSize(type);
+    }
+
+    uint64_t AsyncEvaluator::getStackPointer()
+    {
+        if (!sp)
+        {
+            throw MissingData(MissingData::Kind::STACK_POINTER);
+        }
+        return *sp;
+    }
+
+    uint8_t AsyncEvaluator::getRegContent(uint8_t regNum)
+    {
+        uint8_t val;
+        if (regNum >= regs.size())
+        {
+            throw MissingData(MissingData::Kind::REGISTERS, 0, regNum + 1);
+        }
+        val = regs[regNum];
+        for (const auto &write : regWrites)
+        {
+            if (write.first == regNum)
+            {
+                val = write.second;
+            }
+        }
+        return val;
+    }
+
+    void AsyncEvaluator::setRegContent(uint8_t regNum, uint8_t val)
+    {
+        regWrites.emplace_back(regNum, val);
+    }
+
+    uint8_t AsyncEvaluator::registerCount()
+    {
+        return target_->registerCount();
+    }
+
+    void AsyncEvaluator::getRegisters(std::span<uint8_t> out)
+    {
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            out[i] = getRegContent(i);
+        }
+    }
+
+    void AsyncEvaluator::setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals)
+    {
+        for (size_t i = 0; i < regNums.size() && i < vals.size(); i++)
+        {
+            regWrites.emplace_back(regNums[i], vals[i]);
+        }
+    }
+
+    bool AsyncEvaluator::isTypeName(const std::string &name)
+    {
+        return target_->isTypeName(name);
+    }
+
+    std::shared_ptr<const StructLayout> AsyncEvaluator::getLayout(const std::string &name)
+    {
+        return target_->getLayout(name);
+    }
+
+    void AsyncEvaluator::invalidate()
+    {
+        epoch++;
+        pages.clear();
+        inflight.clear();
+        regs.clear();
+        regFetch.reset();
+        sp.reset();
+        spFetch.reset();
+        invalidateRegisters();
+        invalidateFrame();
+    }
+
+    bool AsyncEvaluator::isVolatile(AddressSpace space)
+    {
+        return space == AddressSpace::SFR || space == AddressSpace::SBIT;
+    }
+
+    void AsyncEvaluator::dropVolatile()
+    {
+        std::erase_if(pages, [](const auto &page)
+                      { return isVolatile(page.first.first); });
+    }
+
+    AsyncEvaluator::Attempt::Attempt(AsyncEvaluator &evaluator, DbgData &staged, bool assignmentAllowed)
+        : evaluator(evaluator), writeMark(evaluator.pendingWrites.size()),
+          previousAssignmentAllowed(SymbolDescriptor::assignmentAllowed)
+    {
+        evaluator.regWrites.clear();
+        SymbolDescriptor::data = &staged;
+        ASTNode::data = &staged;
+        SymbolDescriptor::assignmentAllowed = assignmentAllowed;
+    }
+
+    AsyncEvaluator::Attempt::~Attempt()
+    {
+        // results may still read lazily, through the evaluator rather than the staging buffer
+        SymbolDescriptor::data = &evaluator;
+        ASTNode::data = &evaluator;
+        SymbolDescriptor::assignmentAllowed = previousAssignmentAllowed;
+        evaluator.regWrites.clear();
+        if (!committed)
+        {
+            // unbuffered writes (SFRs) of an attempt that is retried
+            evaluator.pendingWrites.resize(writeMark);
+        }
+    }
+
+    void AsyncEvaluator::Attempt::commit()
+    {
+        committed = true;
+        for (const auto &write : evaluator.regWrites)
+        {
+            if (write.first < evaluator.regs.size())
+            {
+                evaluator.regs[write.first] = write.second;
+            }
+            evaluator.pendingRegNums.push_back(write.first);
+            evaluator.pendingRegVals.push_back(write.second);
+        }
+        evaluator.regWrites.clear();
+        evaluator.invalidateRegisters();
+    }
+
+    // Reads the value of a scalar result, so that it is fetched as well.
+    static void load(const SymbolDescriptor &value)
+    {
+        if (!value.cType.empty() && value.cType[0] != CType::Type::ARRAY &&
+            value.cType[0] != CType::Type::STRUCT && value.cType[0] != CType::Type::UNION)
+        {
+            value.getValue();
+        }
+    }
+
+    Task<std::optional<SymbolDescriptor>> AsyncEvaluator::settle(std::function<SymbolDescriptor()> step, bool assignmentAllowed)
+    {
+        for (int i = 0; i < MAX_ATTEMPTS; i++)
+        {
+            std::optional<MissingData> missing;
+            std::optional<SymbolDescriptor> result;
+            {
+                BufferedDbgData staged(this);
+                Attempt attempt(*this, staged, assignmentAllowed);
+                try
+                {
+                    SymbolDescriptor value = step();
+                    load(value);
+                    result = std::move(value);
+                }
+                catch (const MissingData &m)
+                {
+                    missing = m;
+                }
+                catch (const std::exception &)
+                {
+                    // left for the final evaluation to report
+                }
+            }
+            if (!missing)
+            {
+                co_return result;
+            }
+            try
+            {
+                co_await fetch(*missing);
+            }
+            catch (const std::exception &)
+            {
+                co_return std::nullopt;
+            }
+        }
+        co_return std::nullopt;
+    }
+
+    Task<void> AsyncEvaluator::prefetchReadSet(const CompiledExpression &expr)
+    {
+        try
+        {
+            std::vector<AddressRange> reads = expr.readSet();
+            co_await fetchRanges(reads);
+        }
+        catch (const std::exception &)
+        {
+            // reported by the evaluation
+        }
+    }
+
+    // Runs the fetch walk of the node and keeps its value.
+    static Task<void> fetchInto(const ASTNode *node, AsyncEvaluator &evaluator, bool assignmentAllowed,
+                                std::optional<SymbolDescriptor> &value)
+    {
+        value = co_await node->fetchAsync(evaluator, assignmentAllowed);
+    }
+
+    Task<void> AsyncEvaluator::prepare(const CompiledExpression &expr, bool assignmentAllowed)
+    {
+        // everything known up front goes out at once, next to what the walk needs first
+        std::optional<SymbolDescriptor> value;
+        std::vector<Task<void>> tasks;
+        tasks.push_back(prefetchReadSet(expr));
+        tasks.push_back(fetchInto(expr.root, *this, assignmentAllowed, value));
+        co_await whenAll(std::move(tasks));
+    }
+
+    Task<void> AsyncEvaluator::prepareAll(std::vector<const CompiledExpression *> exprs)
+    {
+        std::vector<Task<void>> tasks;
+        for (const CompiledExpression *expr : exprs)
+        {
+            tasks.push_back(prepare(*expr));
+        }
+        co_await whenAll(std::move(tasks));
+    }
+
+    Task<SymbolDescriptor> AsyncEvaluator::eval(const CompiledExpression &expr, bool assignmentAllowed)
+    {
+        dropVolatile();
+        co_await prepare(expr, assignmentAllowed);
+        for (int i = 0; i < MAX_ATTEMPTS; i++)
+        {
+            std::optional<MissingData> missing;
+            std::optional<SymbolDescriptor> result;
+            std::exception_ptr error;
+            {
+                BufferedDbgData staged(this);
+                Attempt attempt(*this, staged, assignmentAllowed);
+                try
+                {
+                    result = expr.program ? expr.program->run() : expr.root->evaluate();
+                    staged.flush();
+                    attempt.commit();
+                }
+                catch (const MissingData &m)
+                {
+                    missing = m;
+                }
+                catch (...)
+                {
+                    // writes made before the error stay, as with a synchronous target
+                    error = std::current_exception();
+                    staged.flush();
+                    attempt.commit();
+                }
+            }
+            if (missing)
+            {
+                co_await fetch(*missing);
+                continue;
+            }
+            co_await writeBack();
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+            co_await fetchForDisplay(*result);
+            co_return std::move(*result);
+        }
+        throw std::runtime_error("Target data keeps changing during evaluation");
+    }
+
+    Task<void> AsyncEvaluator::fetchForDisplay(const SymbolDescriptor &value)
+    {
+        for (int i = 0; i < MAX_ATTEMPTS; i++)
+        {
+            std::optional<MissingData> missing;
+            try
+            {
+                value.toString();
+            }
+            catch (const MissingData &m)
+            {
+                missing = m;
+            }
+            catch (const std::exception &)
+            {
+                // toString() will report it
+            }
+            if (!missing)
+            {
+                co_return;
+            }
+            try
+            {
+                co_await fetch(*missing);
+            }
+            catch (const std::exception &)
+            {
+                co_return;
+            }
+        }
+    }
+
+    Task<void> AsyncEvaluator::writeBack()
+    {
+        auto writes = std::move(pendingWrites);
+        auto regNums = std::move(pendingRegNums);
+        auto regVals = std::move(pendingRegVals);
+        pendingWrites.clear();
+        pendingRegNums.clear();
+        pendingRegVals.clear();
+        for (const auto &write : writes)
+        {
+            co_await target_->writeMemory(write.space, write.addr, write.bytes);
+        }
+        if (!regNums.empty())
+        {
+            co_await target_->setRegisters(regNums, regVals);
+        }
+    }
+
+    void AsyncEvaluator::complete(Fetch &fetch)
+    {
+        fetch.done = true;
+        auto waiters = std::move(fetch.waiters);
+        fetch.waiters.clear();
+        for (std::coroutine_handle<> waiter : waiters)
+        {
+            waiter.resume();
+        }
+    }
+
+    Task<void> AsyncEvaluator::fetch(MissingData missing)
+    {
+        switch (missing.kind)
+        {
+        case MissingData::Kind::MEMORY:
+        {
+            AddressRange range{missing.addr, missing.size, missing.space};
+            co_await fetchRanges(std::span<const AddressRange>(&range, 1));
+            break;
+        }
+        case MissingData::Kind::REGISTERS:
+            co_await fetchRegisters(missing.size);
+            break;
+        case MissingData::Kind::STACK_POINTER:
+            co_await fetchStackPointer();
+            break;
+        }
+    }
+
+    Task<void> AsyncEvaluator::fetchRanges(std::span<const AddressRange> ranges)
+    {
+        std::vector<std::shared_ptr<Fetch>> waits;
+        std::vector<PageKey> missing;
+        for (const AddressRange &range : ranges)
+        {
+            if (range.size == 0)
+            {
+                continue;
+            }
+            for (uint64_t pageNum = range.addr / PAGE_SIZE; pageNum <= (range.addr + range.size - 1) / PAGE_SIZE; pageNum++)
+            {
+                PageKey key{range.space, pageNum};
+                if (pages.count(key))
+                {
+                    continue;
+                }
+                auto it = inflight.find(key);
+                if (it != inflight.end())
+                {
+                    waits.push_back(it->second);
+                }
+                else
+                {
+                    missing.push_back(key);
+                }
+            }
+        }
+        std::sort(missing.begin(), missing.end());
+        missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+        // one request per run of consecutive pages, all of them in flight together
+        size_t first = 0;
+        while (first < missing.size())
+        {
+            size_t last = first + 1;
+            while (last < missing.size() && missing[last].first == missing[first].first &&
+                   missing[last].second == missing[last - 1].second + 1)
+            {
+                last++;
+            }
+            auto request = std::make_shared<Fetch>();
+            request->epoch = epoch;
+            request->buffer.resize((last - first) * PAGE_SIZE);
+            AddressSpace space = missing[first].first;
+            uint64_t firstPage = missing[first].second;
+            size_t count = last - first;
+            for (size_t i = 0; i < count; i++)
+            {
+                inflight[{space, firstPage + i}] = request;
+            }
+            waits.push_back(request);
+            target_->readMemoryAsync(space, firstPage * PAGE_SIZE, request->buffer, [this, request, space, firstPage, count](std::exception_ptr error)
+                                    {
+                                        for (size_t i = 0; i < count; i++)
+                                        {
+                                            auto it = inflight.find({space, firstPage + i});
+                                            if (it != inflight.end() && it->second == request)
+                                            {
+                                                inflight.erase(it);
+                                            }
+                                            if (!error && request->epoch == epoch)
+                                            {
+                                                auto begin = request->buffer.begin() + i * PAGE_SIZE;
+                                                pages[{space, firstPage + i}].assign(begin, begin + PAGE_SIZE);
+                                            }
+                                        }
+                                        request->error = error;
+                                        complete(*request); });
+            first = last;
+        }
+
+        for (const auto &wait : waits)
+        {
+            co_await FetchAwaiter{wait.get()};
+        }
+    }
+
+    Task<void> AsyncEvaluator::fetchRegisters(size_t count)
+    {
+        if (regs.size() >= count)
+        {
+            co_return;
+        }
+        std::shared_ptr<Fetch> request = regFetch;
+        if (!request || request->done || request->buffer.size() < count)
+        {
+            request = std::make_shared<Fetch>();
+            request->epoch = epoch;
+            request->buffer.resize(std::max<size_t>(count, registerCount()));
+            regFetch = request;
+            target_->getRegistersAsync(request->buffer, [this, request](std::exception_ptr error)
+                                       {
+                                           if (!error && request->epoch == epoch)
+                                           {
+                                               regs = request->buffer;
+                                           }
+                                           request->error = error;
+                                           complete(*request); });
+        }
+        co_await FetchAwaiter{request.get()};
+    }
+
+    Task<void> AsyncEvaluator::fetchStackPointer()
+    {
+        if (sp)
+        {
+            co_return;
+        }
+        std::shared_ptr<Fetch> request = spFetch;
+        if (!request || request->done)
+        {
+            request = std::make_shared<Fetch>();
+            request->epoch = epoch;
+            spFetch = request;
+            target_->getStackPointerAsync(request->value, [this, request](std::exception_ptr error)
+                                          {
+                                              if (!error && request->epoch == epoch)
+                                              {
+                                                  sp = request->value;
+                                              }
+                                              request->error = error;
+                                              complete(*request); });
+        }
+        co_await FetchAwaiter{request.get()};
+    }
+
+    // Fetching walks. Each node first fetches for its operands, concurrently
+    // where they are independent, then settles its own step on their values,
+    // which fetches what the node reads on top of them (a dereference, the
+    // value of a symbol ...). Every node is settled once.
+
+    Task<std::optional<SymbolDescriptor>> ASTNode::fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const
+    {
+        // leaves, evaluating them is the step
+        co_return co_await evaluator.settle([this] { return evaluate(); }, assignmentAllowed);
+    }
+
+    Task<std::optional<SymbolDescriptor>> BinaryOpNode::fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const
+    {
+        std::optional<SymbolDescriptor> lhs, rhs;
+        if (op == Opcode::MEMBER || op == Opcode::PTR_MEMBER)
+        {
+            lhs = co_await left->fetchAsync(evaluator, assignmentAllowed);
+            if (!lhs)
+            {
+                co_return std::nullopt;
+            }
+            const auto &member = static_cast<const SymbolNode &>(*right);
+            co_return co_await evaluator.settle([&]
+                                                { return evalMemberAccess(*lhs, member.name, op == Opcode::PTR_MEMBER); },
+                                                assignmentAllowed);
+        }
+        std::vector<Task<void>> operands;
+        operands.push_back(fetchInto(left, evaluator, assignmentAllowed, lhs));
+        operands.push_back(fetchInto(right, evaluator, assignmentAllowed, rhs));
+        co_await whenAll(std::move(operands));
+        if (!lhs || !rhs)
+        {
+            co_return std::nullopt;
+        }
+        co_return co_await evaluator.settle([&]
+                                            {
+                                                // copies, a step may be retried
+                                                SymbolDescriptor l = *lhs, r = *rhs;
+                                                return evalBinaryOperator(l, r, op); },
+                                            assignmentAllowed);
+    }
+
+    Task<std::optional<SymbolDescriptor>> UnaryOpNode::fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const
+    {
+        std::optional<SymbolDescriptor> value = co_await operand->fetchAsync(evaluator, assignmentAllowed);
+        if (!value)
+        {
+            co_return std::nullopt;
+        }
+        co_return co_await evaluator.settle([&]
+                                            {
+                                                SymbolDescriptor v = *value;
+                                                return evalUnaryOperator(v, op); },
+                                            assignmentAllowed);
+    }
+
+    Task<std::optional<SymbolDescriptor>> CastNode::fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const
+    {
+        std::optional<SymbolDescriptor> value = co_await expression->fetchAsync(evaluator, assignmentAllowed);
+        if (!value)
+        {
+            co_return std::nullopt;
+        }
+        co_return co_await evaluator.settle([&] { return evalCast(*value, type); }, assignmentAllowed);
+    }
+
+    Task<std::optional<SymbolDescriptor>> PromoteNode::fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const
+    {
+        std::optional<SymbolDescriptor> value = co_await operand->fetchAsync(evaluator, assignmentAllowed);
+        if (!value)
+        {
+            co_return std::nullopt;
+        }
+        co_return co_await evaluator.settle([&] { return evalPromote(*value, other, constantOnLeft, op); },
+                                            assignmentAllowed);
+    }
+
+    // Only the operands that evaluation will reach are fetched.
+    static bool decides(const std::optional<SymbolDescriptor> &value, bool &result)
+    {
+        if (!value)
+        {
+            return false;
+        }
+        try
+        {
+            result = value->toBool();
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+    Task<std::optional<SymbolDescriptor>> LogicalNode::fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const
+    {
+        bool value;
+        if (!decides(co_await left->fetchAsync(evaluator, assignmentAllowed), value))
+        {
+            co_return std::nullopt;
+        }
+        if (value == (op == Opcode::LOGICAL_AND) &&
+            !decides(co_await right->fetchAsync(evaluator, assignmentAllowed), value))
+        {
+            co_return std::nullopt;
+        }
+        SymbolDescriptor result;
+        result.fromBool(value);
+        co_return result;
+    }
+
+    Task<std::optional<SymbolDescriptor>> ConditionalNode::fetchAsync(AsyncEvaluator &evaluator, bool assignmentAllowed) const
+    {
+        bool value;
+        if (!decides(co_await condition->fetchAsync(evaluator, assignmentAllowed), value))
+        {
+            co_return std::nullopt;
+        }
+        co_return co_await (value ? whenTrue : whenFalse)->fetchAsync(evaluator, assignmentAllowed);
+    }
+
+} // namespace CdbgExpr
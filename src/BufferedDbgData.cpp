@@ -0,0 +1,278 @@
+#include "BufferedDbgData.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace CdbgExpr
+{
+    BufferedDbgData::BufferedDbgData(DbgData *target)
+        : target_(target)
+    {
+        if (!target_)
+        {
+            throw std::invalid_argument("BufferedDbgData needs a target");
+        }
+        invalidAddress = target_->invalidAddress;
+        model.share(target_->model);
+    }
+
+    SymbolDescriptor BufferedDbgData::getSymbol(const std::string &name)
+    {
+        return target_->getSymbol(name);
+    }
+
+    uint8_t BufferedDbgData::getByte(uint64_t addr)
+    {
+        uint8_t val;
+        readBlock(addr, std::span<uint8_t>(&val, 1));
+        return val;
+    }
+
+    void BufferedDbgData::setByte(uint64_t addr, uint8_t val)
+    {
+        writeBlock(addr, std::span<const uint8_t>(&val, 1));
+    }
+
+    // Writes to these spaces reach the target right away.
+    static bool isUnbuffered(AddressSpace space)
+    {
+        return space == AddressSpace::SFR || space == AddressSpace::SBIT;
+    }
+
+    void BufferedDbgData::readBlock(uint64_t addr, std::span<uint8_t> out)
+    {
+        readMemory(AddressSpace::UNDEFINED, addr, out);
+    }
+
+    void BufferedDbgData::writeBlock(uint64_t addr, std::span<const uint8_t> in)
+    {
+        writeMemory(AddressSpace::UNDEFINED, addr, in);
+    }
+
+    void BufferedDbgData::readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out)
+    {
+        if (out.empty())
+        {
+            return;
+        }
+        auto ranges = pending.find(space);
+        if (ranges == pending.end())
+        {
+            target_->readMemory(space, addr, out);
+            return;
+        }
+        Ranges &spacePending = ranges->second;
+        uint64_t end = addr + out.size();
+
+        // fully covered by one pending range, no need to ask the target
+        auto it = spacePending.upper_bound(addr);
+        if (it != spacePending.begin())
+        {
+            auto prev = std::prev(it);
+            if (prev->first + prev->second.size() >= end)
+            {
+                std::memcpy(out.data(), prev->second.data() + (addr - prev->first), out.size());
+                return;
+            }
+            it = prev;
+        }
+
+        target_->readMemory(space, addr, out);
+        for (; it != spacePending.end() && it->first < end; ++it)
+        {
+            uint64_t rangeEnd = it->first + it->second.size();
+            uint64_t from = std::max(addr, it->first);
+            uint64_t to = std::min(end, rangeEnd);
+            if (from < to)
+            {
+                std::memcpy(out.data() + (from - addr), it->second.data() + (from - it->first), to - from);
+            }
+        }
+    }
+
+    void BufferedDbgData::writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in)
+    {
+        if (in.empty())
+        {
+            return;
+        }
+        if (isUnbuffered(space))
+        {
+            target_->writeMemory(space, addr, in);
+            return;
+        }
+        Ranges &spacePending = pending[space];
+        uint64_t start = addr;
+        uint64_t end = addr + in.size();
+
+        // find all ranges that overlap or touch the new one
+        auto first = spacePending.upper_bound(addr);
+        if (first != spacePending.begin())
+        {
+            auto prev = std::prev(first);
+            if (prev->first + prev->second.size() >= addr)
+            {
+                first = prev;
+            }
+        }
+        auto last = first;
+        while (last != spacePending.end() && last->first <= end)
+        {
+            start = std::min(start, last->first);
+            end = std::max<uint64_t>(end, last->first + last->second.size());
+            ++last;
+        }
+
+        std::vector<uint8_t> merged(end - start);
+        for (auto it = first; it != last; ++it)
+        {
+            std::memcpy(merged.data() + (it->first - start), it->second.data(), it->second.size());
+        }
+        std::memcpy(merged.data() + (addr - start), in.data(), in.size());
+
+        spacePending.erase(first, last);
+        spacePending.emplace(start, std::move(merged));
+    }
+
+    uint8_t BufferedDbgData::CTypeSize(CType type)
+    {
+        return target_->CTypeSize(type);
+    }
+
+    uint64_t BufferedDbgData::getStackPointer()
+    {
+        return target_->getStackPointer();
+    }
+
+    uint8_t BufferedDbgData::getRegContent(uint8_t regNum)
+    {
+        return target_->getRegContent(regNum);
+    }
+
+    void BufferedDbgData::setRegContent(uint8_t regNum, uint8_t val)
+    {
+        target_->setRegContent(regNum, val);
+    }
+
+    uint8_t BufferedDbgData::registerCount()
+    {
+        return target_->registerCount();
+    }
+
+    void BufferedDbgData::getRegisters(std::span<uint8_t> out)
+    {
+        target_->getRegisters(out);
+    }
+
+    void BufferedDbgData::setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals)
+    {
+        target_->setRegisters(regNums, vals);
+    }
+
+    bool BufferedDbgData::isTypeName(const std::string &name)
+    {
+        return target_->isTypeName(name);
+    }
+
+    std::shared_ptr<const StructLayout> BufferedDbgData::getLayout(const std::string &name)
+    {
+        return target_->getLayout(name);
+    }
+
+    void BufferedDbgData::prefetch(std::span<const AddressRange> ranges)
+    {
+        target_->prefetch(ranges);
+    }
+
+    void BufferedDbgData::beginEvaluation()
+    {
+        DbgData::beginEvaluation();
+        target_->beginEvaluation();
+    }
+
+    FrameContext BufferedDbgData::captureFrame()
+    {
+        // the frame selected on the target applies to the buffered writes too
+        return target_->frame();
+    }
+
+    void BufferedDbgData::flush()
+    {
+        while (!pending.empty())
+        {
+            // ranges are removed once written, a failing write leaves the rest pending
+            auto space = pending.begin();
+            while (!space->second.empty())
+            {
+                auto it = space->second.begin();
+                target_->writeMemory(space->first, it->first, it->second);
+                space->second.erase(it);
+                flushCount++;
+            }
+            pending.erase(space);
+        }
+    }
+
+    void BufferedDbgData::discard()
+    {
+        pending.clear();
+    }
+
+    size_t BufferedDbgData::pendingRanges() const
+    {
+        size_t total = 0;
+        for (const auto &space : pending)
+        {
+            total += space.second.size();
+        }
+        return total;
+    }
+
+    size_t BufferedDbgData::pendingBytes() const
+    {
+        size_t total = 0;
+        for (const auto &space : pending)
+        {
+            for (const auto &range : space.second)
+            {
+                total += range.second.size();
+            }
+        }
+        return total;
+    }
+
+    WriteBatch::WriteBatch(BufferedDbgData &buffer, bool discardOnError)
+        : buffer(buffer), discardOnError(discardOnError)
+    {
+    }
+
+    WriteBatch::~WriteBatch()
+    {
+        if (committed)
+        {
+            return;
+        }
+        if (discardOnError)
+        {
+            buffer.discard();
+            return;
+        }
+        try
+        {
+            buffer.flush();
+        }
+        catch (...)
+        {
+            // nothing sensible to do while unwinding, drop what could not be written
+            buffer.discard();
+        }
+    }
+
+    void WriteBatch::commit()
+    {
+        committed = true;
+        buffer.flush();
+    }
+
+} // namespace CdbgExpr
@@ -0,0 +1,154 @@
+#include "Bytecode.h"
+#include "CdbgExpr.h"
+#include <array>
+#include <stdexcept>
+
+namespace CdbgExpr
+{
+    void BytecodeProgram::emit(BytecodeOp op, Opcode exprOp, uint16_t arg)
+    {
+        switch (op)
+        {
+        case BytecodeOp::PUSH_CONST:
+        case BytecodeOp::LOAD_SYMBOL:
+            depth++;
+            break;
+        case BytecodeOp::INDEX:
+        case BytecodeOp::BINARY:
+        case BytecodeOp::POP:
+        case BytecodeOp::BRANCH_IF_FALSE:
+            depth--;
+            break;
+        default:
+            break;
+        }
+        if (depth > STACK_SIZE)
+        {
+            throw std::runtime_error("Expression too complex for the bytecode stack");
+        }
+        if (code.size() >= UINT16_MAX)
+        {
+            throw std::runtime_error("Expression too long for bytecode");
+        }
+        code.push_back({op, exprOp, arg});
+    }
+
+    uint16_t BytecodeProgram::label() const
+    {
+        return static_cast<uint16_t>(code.size());
+    }
+
+    void BytecodeProgram::patch(uint16_t at, uint16_t target)
+    {
+        code[at].arg = target;
+    }
+
+    uint16_t BytecodeProgram::addConstant(const SymbolDescriptor &value)
+    {
+        constants.push_back(value);
+        return static_cast<uint16_t>(constants.size() - 1);
+    }
+
+    uint16_t BytecodeProgram::addName(const std::string &name)
+    {
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            if (names[i] == name)
+            {
+                return static_cast<uint16_t>(i);
+            }
+        }
+        names.push_back(name);
+        return static_cast<uint16_t>(names.size() - 1);
+    }
+
+    uint16_t BytecodeProgram::addCastType(const CastType &type)
+    {
+        castTypes.push_back(type);
+        return static_cast<uint16_t>(castTypes.size() - 1);
+    }
+
+    SymbolDescriptor BytecodeProgram::run() const
+    {
+        if (ASTNode::data == nullptr)
+        {
+            throw std::runtime_error("DbgData pointer is null");
+        }
+
+        std::array<SymbolDescriptor, STACK_SIZE> stack;
+        size_t sp = 0;
+        for (size_t pc = 0; pc < code.size(); pc++)
+        {
+            const Instruction &ins = code[pc];
+            switch (ins.code)
+            {
+            case BytecodeOp::PUSH_CONST:
+                stack[sp++] = constants[ins.arg];
+                break;
+            case BytecodeOp::LOAD_SYMBOL:
+                stack[sp++] = ASTNode::data->getSymbol(names[ins.arg]);
+                break;
+            case BytecodeOp::DEREF:
+                stack[sp - 1] = stack[sp - 1].dereference();
+                break;
+            case BytecodeOp::ADDRESS_OF:
+                stack[sp - 1] = stack[sp - 1].addressOf();
+                break;
+            case BytecodeOp::MEMBER:
+            case BytecodeOp::PTR_MEMBER:
+                stack[sp - 1] = evalMemberAccess(stack[sp - 1], names[ins.arg], ins.code == BytecodeOp::PTR_MEMBER);
+                break;
+            case BytecodeOp::INDEX:
+                sp--;
+                stack[sp - 1] = evalArrayAccess(stack[sp - 1], stack[sp]);
+                break;
+            case BytecodeOp::UNARY:
+                stack[sp - 1] = evalUnaryOperator(stack[sp - 1], ins.op);
+                break;
+            case BytecodeOp::BINARY:
+                sp--;
+                stack[sp - 1] = evalBinaryOperator(stack[sp - 1], stack[sp], ins.op);
+                break;
+            case BytecodeOp::CAST:
+                stack[sp - 1] = evalCast(stack[sp - 1], castTypes[ins.arg]);
+                break;
+            case BytecodeOp::PROMOTE:
+            case BytecodeOp::PROMOTE_LEFT:
+                stack[sp - 1] = evalPromote(stack[sp - 1], constants[ins.arg], ins.code == BytecodeOp::PROMOTE_LEFT, ins.op);
+                break;
+            case BytecodeOp::TO_BOOL:
+            {
+                bool val = stack[sp - 1].toBool();
+                stack[sp - 1] = SymbolDescriptor();
+                stack[sp - 1].fromBool(val);
+                break;
+            }
+            case BytecodeOp::POP:
+                sp--;
+                break;
+            case BytecodeOp::JUMP:
+                pc = ins.arg - 1;
+                break;
+            case BytecodeOp::JUMP_IF_FALSE:
+                if (!stack[sp - 1].toBool())
+                    pc = ins.arg - 1;
+                break;
+            case BytecodeOp::JUMP_IF_TRUE:
+                if (stack[sp - 1].toBool())
+                    pc = ins.arg - 1;
+                break;
+            case BytecodeOp::BRANCH_IF_FALSE:
+                sp--;
+                if (!stack[sp].toBool())
+                    pc = ins.arg - 1;
+                break;
+            }
+        }
+
+        if (sp != 1)
+        {
+            throw std::runtime_error("Corrupted bytecode stack");
+        }
+        return std::move(stack[0]);
+    }
+} // namespace CdbgExpr
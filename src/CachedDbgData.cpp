@@ -0,0 +1,260 @@
+#include "CachedDbgData.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace CdbgExpr
+{
+    CachedDbgData::CachedDbgData(DbgData *target, size_t pageSize)
+        : target_(target), pageSize_(pageSize)
+    {
+        if (!target_)
+        {
+            throw std::invalid_argument("CachedDbgData needs a target");
+        }
+        if (pageSize_ == 0)
+        {
+            throw std::invalid_argument("Page size must not be zero");
+        }
+        invalidAddress = target_->invalidAddress;
+        model.share(target_->model);
+        keepSnapshots = true; // dropped by invalidate()
+
+        policies.fill(Policy::PER_STOP);
+        setPolicy(AddressSpace::CODE, Policy::SESSION);
+        setPolicy(AddressSpace::CODE_STATIC, Policy::SESSION);
+        setPolicy(AddressSpace::SFR, Policy::NEVER);
+        setPolicy(AddressSpace::SBIT, Policy::NEVER);
+    }
+
+    SymbolDescriptor CachedDbgData::getSymbol(const std::string &name)
+    {
+        return target_->getSymbol(name);
+    }
+
+    uint8_t CachedDbgData::getByte(uint64_t addr)
+    {
+        uint8_t val;
+        readBlock(addr, std::span<uint8_t>(&val, 1));
+        return val;
+    }
+
+    void CachedDbgData::setByte(uint64_t addr, uint8_t val)
+    {
+        writeBlock(addr, std::span<const uint8_t>(&val, 1));
+    }
+
+    bool CachedDbgData::isValid(const PageKey &key, const Page &page) const
+    {
+        return !page.bytes.empty() && (page.epoch == currentEpoch || policy(key.space) == Policy::SESSION);
+    }
+
+    CachedDbgData::Page &CachedDbgData::fetch(const PageKey &key)
+    {
+        auto it = pages.find(key);
+        if (it != pages.end() && isValid(key, it->second))
+        {
+            hitCount++;
+            return it->second;
+        }
+        missCount++;
+        // installed only once read, a failed read must not leave a valid page
+        std::vector<uint8_t> bytes(pageSize_);
+        target_->readMemory(key.space, key.pageNum * pageSize_, bytes);
+        Page &page = pages[key];
+        page.bytes = std::move(bytes);
+        page.epoch = currentEpoch;
+        return page;
+    }
+
+    void CachedDbgData::readBlock(uint64_t addr, std::span<uint8_t> out)
+    {
+        readMemory(AddressSpace::UNDEFINED, addr, out);
+    }
+
+    void CachedDbgData::writeBlock(uint64_t addr, std::span<const uint8_t> in)
+    {
+        writeMemory(AddressSpace::UNDEFINED, addr, in);
+    }
+
+    void CachedDbgData::readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out)
+    {
+        if (policy(space) == Policy::NEVER)
+        {
+            target_->readMemory(space, addr, out);
+            return;
+        }
+        size_t done = 0;
+        while (done < out.size())
+        {
+            uint64_t pageNum = (addr + done) / pageSize_;
+            size_t offset = (addr + done) % pageSize_;
+            size_t count = std::min(pageSize_ - offset, out.size() - done);
+            const Page &page = fetch({space, pageNum});
+            std::memcpy(out.data() + done, page.bytes.data() + offset, count);
+            done += count;
+        }
+    }
+
+    void CachedDbgData::writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in)
+    {
+        target_->writeMemory(space, addr, in);
+        if (policy(space) == Policy::NEVER)
+        {
+            return;
+        }
+
+        // keep pages that are still valid in sync, stale ones are refetched anyway
+        size_t done = 0;
+        while (done < in.size())
+        {
+            PageKey key{space, (addr + done) / pageSize_};
+            size_t offset = (addr + done) % pageSize_;
+            size_t count = std::min(pageSize_ - offset, in.size() - done);
+            auto it = pages.find(key);
+            if (it != pages.end() && isValid(key, it->second))
+            {
+                std::memcpy(it->second.bytes.data() + offset, in.data() + done, count);
+            }
+            done += count;
+        }
+    }
+
+    uint8_t CachedDbgData::CTypeSize(CType type)
+    {
+        return target_->CTypeSize(type);
+    }
+
+    uint64_t CachedDbgData::getStackPointer()
+    {
+        return target_->getStackPointer();
+    }
+
+    uint8_t CachedDbgData::getRegContent(uint8_t regNum)
+    {
+        return target_->getRegContent(regNum);
+    }
+
+    void CachedDbgData::setRegContent(uint8_t regNum, uint8_t val)
+    {
+        target_->setRegContent(regNum, val);
+    }
+
+    uint8_t CachedDbgData::registerCount()
+    {
+        return target_->registerCount();
+    }
+
+    void CachedDbgData::getRegisters(std::span<uint8_t> out)
+    {
+        target_->getRegisters(out);
+    }
+
+    void CachedDbgData::setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals)
+    {
+        target_->setRegisters(regNums, vals);
+    }
+
+    bool CachedDbgData::isTypeName(const std::string &name)
+    {
+        return target_->isTypeName(name);
+    }
+
+    std::shared_ptr<const StructLayout> CachedDbgData::getLayout(const std::string &name)
+    {
+        return target_->getLayout(name);
+    }
+
+    void CachedDbgData::prefetch(std::span<const AddressRange> ranges)
+    {
+        std::vector<PageKey> missing;
+        for (const AddressRange &range : ranges)
+        {
+            if (range.size == 0 || policy(range.space) == Policy::NEVER)
+            {
+                continue;
+            }
+            for (uint64_t pageNum = range.addr / pageSize_; pageNum <= (range.addr + range.size - 1) / pageSize_; pageNum++)
+            {
+                PageKey key{range.space, pageNum};
+                auto it = pages.find(key);
+                if (it == pages.end() || !isValid(key, it->second))
+                {
+                    missing.push_back(key);
+                }
+            }
+        }
+        auto less = [](const PageKey &a, const PageKey &b)
+        { return a.space != b.space ? a.space < b.space : a.pageNum < b.pageNum; };
+        std::sort(missing.begin(), missing.end(), less);
+        missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+        std::vector<uint8_t> buffer;
+        size_t first = 0;
+        while (first < missing.size())
+        {
+            size_t last = first + 1;
+            while (last < missing.size() && missing[last].space == missing[first].space &&
+                   missing[last].pageNum == missing[last - 1].pageNum + 1)
+            {
+                last++;
+            }
+            buffer.resize((last - first) * pageSize_);
+            target_->readMemory(missing[first].space, missing[first].pageNum * pageSize_, buffer);
+            for (size_t i = first; i < last; i++)
+            {
+                Page &page = pages[missing[i]];
+                page.bytes.assign(buffer.begin() + (i - first) * pageSize_, buffer.begin() + (i - first + 1) * pageSize_);
+                page.epoch = currentEpoch;
+                missCount++;
+            }
+            first = last;
+        }
+    }
+
+    void CachedDbgData::setPolicy(AddressSpace space, Policy policy)
+    {
+        policies[static_cast<uint8_t>(space)] = policy;
+        if (policy == Policy::NEVER)
+        {
+            std::erase_if(pages, [space](const auto &entry)
+                          { return entry.first.space == space; });
+        }
+    }
+
+    void CachedDbgData::invalidate()
+    {
+        // stale pages are detected by their epoch
+        currentEpoch++;
+        invalidateRegisters();
+        invalidateFrame();
+    }
+
+    void CachedDbgData::setEpoch(uint64_t stopEpoch)
+    {
+        if (stopEpoch != currentEpoch)
+        {
+            currentEpoch = stopEpoch;
+            // epochs may repeat, keep only what does not depend on them
+            std::erase_if(pages, [this](const auto &entry)
+                          { return policy(entry.first.space) != Policy::SESSION; });
+            invalidateRegisters();
+            invalidateFrame();
+        }
+    }
+
+    void CachedDbgData::clear()
+    {
+        pages.clear();
+        invalidateRegisters();
+        invalidateFrame();
+    }
+
+    void CachedDbgData::resetStats()
+    {
+        hitCount = 0;
+        missCount = 0;
+    }
+
+} // namespace CdbgExpr
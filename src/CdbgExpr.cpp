@@ -1,14 +1,15 @@
 #include "CdbgExpr.h"
+#include "Bytecode.h"
 #include <cstdint>
+#include <bit>
+#include <algorithm>
 #include <iostream>
 #include <vector>
-#include <unordered_map>
-#include <set>
 
 namespace CdbgExpr
 {
     Expression::Expression(const std::string &expr, DbgData *dbgData)
-        : expr_(expr), pos_(0), dbgData(dbgData)
+        : expr_(expr), dbgData(dbgData)
     {
         SymbolDescriptor::data = dbgData;
         ASTNode::data = dbgData;
@@ -16,636 +17,1335 @@ namespace CdbgExpr
 
     SymbolDescriptor Expression::eval(bool assignmentAllowed)
     {
-        tokenize(expr_);
-        pos_ = 0;
-        SymbolDescriptor::assignmentAllowed = assignmentAllowed;
-        ExpressionParser expParser(tokens, dbgData);
-        return expParser.parse()->evaluate(); // Evaluate the expression
+        if (!compiled)
+        {
+            compiled = std::make_unique<CompiledExpression>(expr_, dbgData);
+        }
+        return compiled->eval(assignmentAllowed);
     }
 
     Expression::~Expression() {}
 
-    void Expression::tokenize(const std::string &expr)
+    // Sorts the ranges and merges the ones in the same space that overlap or touch.
+    static void coalesceRanges(std::vector<AddressRange> &ranges)
     {
-        std::vector<std::string> rawTokens;
-        std::string token;
-        uint64_t i = 0;
-
-        static const std::set<std::string> multiCharOperators = {
-            "==", "!=", "<=", ">=", "&&", "||", "->", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "<<", ">>"
-        };
+        std::sort(ranges.begin(), ranges.end(), [](const AddressRange &a, const AddressRange &b)
+                  { return a.space != b.space ? a.space < b.space : a.addr < b.addr; });
+        size_t out = 0;
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            if (out > 0 && ranges[i].space == ranges[out - 1].space &&
+                ranges[i].addr <= ranges[out - 1].addr + ranges[out - 1].size)
+            {
+                uint64_t end = std::max(ranges[out - 1].addr + ranges[out - 1].size, ranges[i].addr + ranges[i].size);
+                ranges[out - 1].size = end - ranges[out - 1].addr;
+            }
+            else
+            {
+                ranges[out++] = ranges[i];
+            }
+        }
+        ranges.resize(out);
+    }
 
-        // First Pass: Raw token extraction
-        while (i < expr.size())
+    CompiledExpression::CompiledExpression(const std::string &expr, DbgData *dbgData, Backend backend)
+        : expr_(expr), dbgData(dbgData), backend_(backend)
+    {
+        SymbolDescriptor::data = dbgData;
+        ASTNode::data = dbgData;
+        ExpressionParser expParser(tokenize(expr_), dbgData, arena);
+        ASTNode *ast = expParser.parse();
+        root = ast->optimize(arena);
+        if (backend_ == Backend::BYTECODE)
         {
-            char c = expr[i];
+            program = std::make_unique<BytecodeProgram>();
+            root->compile(*program);
+        }
+    }
+
+    CompiledExpression::~CompiledExpression() {}
 
-            if (std::isspace(c))
+    std::vector<AddressRange> CompiledExpression::readSet() const
+    {
+        SymbolDescriptor::data = dbgData;
+        ASTNode::data = dbgData;
+        std::vector<AddressRange> reads;
+        root->collectReads(reads);
+        coalesceRanges(reads);
+        return reads;
+    }
+
+    SymbolDescriptor CompiledExpression::eval(bool assignmentAllowed) const
+    {
+        SymbolDescriptor::data = dbgData;
+        ASTNode::data = dbgData;
+        SymbolDescriptor::assignmentAllowed = assignmentAllowed;
+        dbgData->beginEvaluation();
+        std::vector<AddressRange> reads = readSet();
+        if (!reads.empty())
+        {
+            try
             {
-                i++;
-                continue;
+                dbgData->prefetch(reads);
             }
-
-            // --- STRING LITERALS ---
-            if (c == '"' || c == '\'')
+            catch (const std::exception &)
             {
-                char quote = c;
-                token.clear();
-                token += quote;
-                i++;
-                while (i < expr.size())
-                {
-                    char ch = expr[i];
-                    token += ch;
-                    i++;
-                    if (ch == '\\' && i < expr.size())  // Escape character
-                    {
-                        token += expr[i];
-                        i++;
-                        continue;
-                    }
-                    if (ch == quote)
-                        break;
-                }
-                rawTokens.push_back(token);
-                continue;
+                // only a hint, the evaluation reports what it cannot read
             }
+        }
+        if (program)
+        {
+            return program->run();
+        }
+        return root->evaluate();
+    }
 
-            // --- FLOATING POINT OR INTEGER NUMBERS ---
-            if (std::isdigit(c) || (c == '.' && i + 1 < expr.size() && std::isdigit(expr[i + 1])) || 
-                (c == '0' && i + 1 < expr.size() && (expr[i + 1] == 'x' || expr[i + 1] == 'X' || expr[i + 1] == 'b' || expr[i + 1] == 'B')))
-            {
-                token.clear();
+    static constexpr int UNARY_PRECEDENCE = 16; // for unary + - * & ! ~ and casts
 
-                if (expr[i] == '0' && i + 1 < expr.size() && (expr[i + 1] == 'x' || expr[i + 1] == 'X'))
-                {
-                    // Hex literal: 0x...
-                    token += expr[i++];
-                    token += expr[i++];
-                    while (i < expr.size() && std::isxdigit(expr[i]))
-                    {
-                        token += expr[i++];
-                    }
-                }
-                else if (expr[i] == '0' && i + 1 < expr.size() && (expr[i + 1] == 'b' || expr[i + 1] == 'B'))
-                {
-                    // Binary literal: 0b...
-                    token += expr[i++];
-                    token += expr[i++];
-                    while (i < expr.size() && (expr[i] == '0' || expr[i] == '1'))
-                    {
-                        token += expr[i++];
-                    }
-                }
-                else
-                {
-                    // Decimal or floating point
-                    bool hasDot = false;
-                    bool hasExp = false;
-                    while (i < expr.size())
-                    {
-                        char ch = expr[i];
-                        if (std::isdigit(ch))
-                        {
-                            token += ch;
-                            i++;
-                        }
-                        else if (ch == '.' && !hasDot)
-                        {
-                            hasDot = true;
-                            token += ch;
-                            i++;
-                        }
-                        else if ((ch == 'e' || ch == 'E') && !hasExp)
-                        {
-                            hasExp = true;
-                            token += ch;
-                            i++;
-                            if (i < expr.size() && (expr[i] == '+' || expr[i] == '-'))
-                            {
-                                token += expr[i++];
-                            }
-                        }
-                        else
-                        {
-                            break;
-                        }
-                    }
+    static int binaryPrecedence(Opcode op)
+    {
+        switch (op)
+        {
+        case Opcode::MEMBER:
+        case Opcode::PTR_MEMBER:
+        case Opcode::INDEX:
+            return 18;
+        case Opcode::MUL:
+        case Opcode::DIV:
+        case Opcode::MOD:
+            return 15;
+        case Opcode::ADD:
+        case Opcode::SUB:
+            return 14;
+        case Opcode::SHL:
+        case Opcode::SHR:
+            return 13;
+        case Opcode::LT:
+        case Opcode::LE:
+        case Opcode::GT:
+        case Opcode::GE:
+            return 12;
+        case Opcode::EQ:
+        case Opcode::NE:
+            return 11;
+        case Opcode::BIT_AND:
+            return 10;
+        case Opcode::BIT_XOR:
+            return 9;
+        case Opcode::BIT_OR:
+            return 8;
+        case Opcode::LOGICAL_AND:
+            return 7;
+        case Opcode::LOGICAL_OR:
+            return 6;
+        case Opcode::CONDITIONAL:
+            return 5;
+        case Opcode::ASSIGN:
+        case Opcode::ADD_ASSIGN:
+        case Opcode::SUB_ASSIGN:
+        case Opcode::MUL_ASSIGN:
+        case Opcode::DIV_ASSIGN:
+        case Opcode::MOD_ASSIGN:
+        case Opcode::AND_ASSIGN:
+        case Opcode::OR_ASSIGN:
+        case Opcode::XOR_ASSIGN:
+        case Opcode::SHL_ASSIGN:
+        case Opcode::SHR_ASSIGN:
+            return 4;
+        case Opcode::COMMA:
+            return 3;
+        default:
+            return 0; // unknown or non-operator
+        }
+    }
 
-                    // Optional float suffix (f/F, l/L)
-                    if (i < expr.size() && (expr[i] == 'f' || expr[i] == 'F' || expr[i] == 'l' || expr[i] == 'L'))
-                    {
-                        token += expr[i++];
-                    }
-                }
+    Lexer::Lexer(std::string_view src) : src(src) {}
 
-                // Optional integer suffix (u/U, l/L, ul/UL, etc.)
-                while (i < expr.size() && (expr[i] == 'u' || expr[i] == 'U' || expr[i] == 'l' || expr[i] == 'L'))
-                {
-                    token += expr[i++];
-                }
+    bool Lexer::expectsOperand() const
+    {
+        if (!hasPrev)
+        {
+            return true;
+        }
+        return prevType != TokenType::SYMBOL &&
+               prevType != TokenType::NUMBER &&
+               prevOp != Opcode::RPAREN &&
+               prevOp != Opcode::RBRACKET;
+    }
 
-                rawTokens.push_back(token);
-                continue;
-            }
+    bool Lexer::next(Token &token)
+    {
+        while (pos < src.size() && std::isspace(static_cast<unsigned char>(src[pos])))
+        {
+            pos++;
+        }
+        if (pos >= src.size())
+        {
+            return false;
+        }
+
+        size_t start = pos;
+        char c = src[pos];
+        token.op = Opcode::NONE;
+        token.precedence = 0;
 
-            // --- SYMBOLS (identifiers) ---
-            if (std::isalpha(c) || c == '_')
+        // --- STRING LITERALS ---
+        if (c == '"' || c == '\'')
+        {
+            pos++;
+            while (pos < src.size())
             {
-                token.clear();
-                while (i < expr.size() && (std::isalnum(expr[i]) || expr[i] == '_'))
+                char ch = src[pos++];
+                if (ch == '\\' && pos < src.size()) // Escape character
                 {
-                    token += expr[i];
-                    i++;
+                    pos++;
+                    continue;
                 }
-                rawTokens.push_back(token);
-                continue;
+                if (ch == c)
+                    break;
             }
-
-            // --- MULTI-CHARACTER OPERATORS ---
-            bool matched = false;
-            for (int len = 3; len >= 2; --len)
+            token.type = TokenType::STRING_LITERAL;
+        }
+        // --- FLOATING POINT OR INTEGER NUMBERS ---
+        else if (std::isdigit(static_cast<unsigned char>(c)) ||
+                 (c == '.' && pos + 1 < src.size() && std::isdigit(static_cast<unsigned char>(src[pos + 1]))))
+        {
+            scanNumber(token);
+        }
+        // --- SYMBOLS (identifiers) ---
+        else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+        {
+            while (pos < src.size() && (std::isalnum(static_cast<unsigned char>(src[pos])) || src[pos] == '_'))
             {
-                if (i + len <= expr.size())
-                {
-                    std::string op = expr.substr(i, len);
-                    if (multiCharOperators.count(op))
-                    {
-                        rawTokens.push_back(op);
-                        i += len;
-                        matched = true;
-                        break;
-                    }
-                }
+                pos++;
             }
-            if (matched) continue;
-
-            // --- SINGLE CHARACTER TOKEN ---
-            rawTokens.push_back(std::string(1, expr[i]));
-            i++;
+            token.type = TokenType::SYMBOL;
+        }
+        else
+        {
+            scanOperator(token);
         }
 
-        // Second Pass: Type assignment
-        for (size_t j = 0; j < rawTokens.size(); ++j)
+        token.value = src.substr(start, pos - start);
+        if (token.type == TokenType::NUMBER && !SymbolDescriptor::decodeLiteral(token.value, token.literal))
         {
-            const std::string &tok = rawTokens[j];
-            TokenType type;
+            throw std::runtime_error("Invalid numeric literal: " + std::string(token.value));
+        }
+        hasPrev = true;
+        prevType = token.type;
+        prevOp = token.op;
+        return true;
+    }
 
-            if (tok == "(" || tok == ")")
-            {
-                type = TokenType::PARENTHESIS;
-            }
-            else if (tok == "[" || tok == "]")
-            {
-                type = TokenType::ARRAY_ACCESS;
-            }
-            else if (tok == "." || tok == "->")
-            {
-                type = TokenType::STRUCT_ACCESS;
-            }
-            else if ((tok.front() == '"' && tok.back() == '"') || (tok.front() == '\'' && tok.back() == '\''))
-            {
-                type = TokenType::STRING_LITERAL;
-            }
-            else if (std::isdigit(tok[0]) || tok[0] == '.')
+    bool Lexer::scanNumber(Token &token)
+    {
+        token.type = TokenType::NUMBER;
+        if (src[pos] == '0' && pos + 1 < src.size() && (src[pos + 1] == 'x' || src[pos + 1] == 'X'))
+        {
+            // Hex literal: 0x...
+            pos += 2;
+            while (pos < src.size() && std::isxdigit(static_cast<unsigned char>(src[pos])))
             {
-                type = TokenType::NUMBER;
+                pos++;
             }
-            else if (std::isalpha(tok[0]) || tok[0] == '_')
+        }
+        else if (src[pos] == '0' && pos + 1 < src.size() && (src[pos + 1] == 'b' || src[pos + 1] == 'B'))
+        {
+            // Binary literal: 0b...
+            pos += 2;
+            while (pos < src.size() && (src[pos] == '0' || src[pos] == '1'))
             {
-                type = TokenType::SYMBOL;
+                pos++;
             }
-            else if (tok == "+" || tok == "-" || tok == "*" || tok == "&" || tok == "=")
+        }
+        else
+        {
+            // Decimal or floating point
+            bool hasDot = false;
+            bool hasExp = false;
+            while (pos < src.size())
             {
-                if (tokens.empty() || (tokens.back().type != TokenType::SYMBOL &&
-                                    tokens.back().type != TokenType::NUMBER &&
-                                    tokens.back().type != TokenType::PARENTHESIS &&
-                                    tokens.back().value != ")"))
-                    type = TokenType::UNARY_OPERATOR;
+                char ch = src[pos];
+                if (std::isdigit(static_cast<unsigned char>(ch)))
+                {
+                    pos++;
+                }
+                else if (ch == '.' && !hasDot && !hasExp)
+                {
+                    hasDot = true;
+                    pos++;
+                }
+                else if ((ch == 'e' || ch == 'E') && !hasExp)
+                {
+                    hasExp = true;
+                    pos++;
+                    if (pos < src.size() && (src[pos] == '+' || src[pos] == '-'))
+                    {
+                        pos++;
+                    }
+                }
                 else
-                    type = TokenType::OPERATOR;
+                {
+                    break;
+                }
             }
-            else
+
+            // Optional float suffix (f/F)
+            if ((hasDot || hasExp) && pos < src.size() && (src[pos] == 'f' || src[pos] == 'F'))
             {
-                type = TokenType::OPERATOR;
+                pos++;
             }
+        }
 
-            tokens.push_back({type, tok});
+        // Optional integer suffix (u/U, l/L, ul/UL, etc.)
+        while (pos < src.size() && (src[pos] == 'u' || src[pos] == 'U' || src[pos] == 'l' || src[pos] == 'L'))
+        {
+            pos++;
         }
+        return true;
     }
 
-    int getPrecedence(const Token &token)
+    bool Lexer::scanOperator(Token &token)
     {
-        static const std::unordered_map<std::string, int> precedence = {
-            {"[]", 18}, {".", 18}, {"->", 18},                    // member access
-            {"++", 17}, {"--", 17},                               // postfix
-            {"*", 15}, {"/", 15}, {"%", 15},                      // multiplicative
-            {"+", 14}, {"-", 14},                                 // additive
-            {"<<", 13}, {">>", 13},                               // shift
-            {"<", 12}, {"<=", 12}, {">", 12}, {">=", 12},         // relational
-            {"==", 11}, {"!=", 11},                               // equality
-            {"&", 10},
-            {"^", 9},
-            {"|", 8},
-            {"&&", 7},
-            {"||", 6},
-            {"?", 5}, {":", 5},
-            {"=", 4}, {"+=", 4}, {"-=", 4}, {"*=", 4}, {"/=", 4},
-            {"%=", 4}, {"<<=", 4}, {">>=", 4}, {"&=", 4}, {"^=", 4}, {"|=", 4},
-            {",", 3}
+        char c = src[pos++];
+        char n = pos < src.size() ? src[pos] : '\0';
+        char n2 = pos + 1 < src.size() ? src[pos + 1] : '\0';
+        bool unary = expectsOperand();
+
+        auto take = [&](size_t len, Opcode op)
+        {
+            pos += len;
+            token.op = op;
         };
 
-        if (token.type == TokenType::PARENTHESIS)
+        token.type = TokenType::OPERATOR;
+        switch (c)
         {
-            return -1; // used structurally, not as operators
+        case '(':
+            token.type = TokenType::PARENTHESIS;
+            token.op = Opcode::LPAREN;
+            token.precedence = -1; // used structurally, not as operators
+            return true;
+        case ')':
+            token.type = TokenType::PARENTHESIS;
+            token.op = Opcode::RPAREN;
+            token.precedence = -1;
+            return true;
+        case '[':
+            token.type = TokenType::ARRAY_ACCESS;
+            token.op = Opcode::LBRACKET;
+            token.precedence = binaryPrecedence(Opcode::INDEX);
+            return true;
+        case ']':
+            token.type = TokenType::ARRAY_ACCESS;
+            token.op = Opcode::RBRACKET;
+            return true;
+        case '.':
+            token.type = TokenType::STRUCT_ACCESS;
+            token.op = Opcode::MEMBER;
+            token.precedence = binaryPrecedence(token.op);
+            return true;
+        case '+':
+            n == '=' ? take(1, Opcode::ADD_ASSIGN) : take(0, Opcode::ADD);
+            break;
+        case '-':
+            if (n == '>')
+            {
+                take(1, Opcode::PTR_MEMBER);
+                token.type = TokenType::STRUCT_ACCESS;
+                token.precedence = binaryPrecedence(token.op);
+                return true;
+            }
+            n == '=' ? take(1, Opcode::SUB_ASSIGN) : take(0, Opcode::SUB);
+            break;
+        case '*':
+            n == '=' ? take(1, Opcode::MUL_ASSIGN) : take(0, Opcode::MUL);
+            break;
+        case '/':
+            n == '=' ? take(1, Opcode::DIV_ASSIGN) : take(0, Opcode::DIV);
+            break;
+        case '%':
+            n == '=' ? take(1, Opcode::MOD_ASSIGN) : take(0, Opcode::MOD);
+            break;
+        case '&':
+            if (n == '&')
+                take(1, Opcode::LOGICAL_AND);
+            else
+                n == '=' ? take(1, Opcode::AND_ASSIGN) : take(0, Opcode::BIT_AND);
+            break;
+        case '|':
+            if (n == '|')
+                take(1, Opcode::LOGICAL_OR);
+            else
+                n == '=' ? take(1, Opcode::OR_ASSIGN) : take(0, Opcode::BIT_OR);
+            break;
+        case '^':
+            n == '=' ? take(1, Opcode::XOR_ASSIGN) : take(0, Opcode::BIT_XOR);
+            break;
+        case '~':
+            take(0, Opcode::BIT_NOT);
+            break;
+        case '!':
+            n == '=' ? take(1, Opcode::NE) : take(0, Opcode::LOGICAL_NOT);
+            break;
+        case '=':
+            n == '=' ? take(1, Opcode::EQ) : take(0, Opcode::ASSIGN);
+            break;
+        case '<':
+            if (n == '<')
+                n2 == '=' ? take(2, Opcode::SHL_ASSIGN) : take(1, Opcode::SHL);
+            else
+                n == '=' ? take(1, Opcode::LE) : take(0, Opcode::LT);
+            break;
+        case '>':
+            if (n == '>')
+                n2 == '=' ? take(2, Opcode::SHR_ASSIGN) : take(1, Opcode::SHR);
+            else
+                n == '=' ? take(1, Opcode::GE) : take(0, Opcode::GT);
+            break;
+        case '?':
+            take(0, Opcode::CONDITIONAL);
+            break;
+        case ':':
+            take(0, Opcode::COLON);
+            break;
+        case ',':
+            take(0, Opcode::COMMA);
+            break;
+        default:
+            return true;
         }
-        else if (token.type == TokenType::STRUCT_ACCESS)
+
+        bool canBeUnary = token.op == Opcode::ADD || token.op == Opcode::SUB ||
+                          token.op == Opcode::MUL || token.op == Opcode::BIT_AND;
+        if ((unary && canBeUnary) || token.op == Opcode::BIT_NOT || token.op == Opcode::LOGICAL_NOT)
         {
-            return 18;
+            token.type = TokenType::UNARY_OPERATOR;
+            token.precedence = UNARY_PRECEDENCE;
         }
-        else if (token.type == TokenType::UNARY_OPERATOR)
+        else
         {
-            return 16; // for unary + - * & ! ~
+            token.precedence = binaryPrecedence(token.op);
         }
-        else if (precedence.contains(token.value))
+        return true;
+    }
+
+    std::vector<Token> tokenize(std::string_view expr)
+    {
+        std::vector<Token> tokens;
+        tokens.reserve(expr.size() / 2 + 1);
+
+        Lexer lexer(expr);
+        Token token;
+        while (lexer.next(token))
         {
-            return precedence.at(token.value);
+            tokens.push_back(token);
         }
-        return 0; // unknown or non-operator
+        return tokens;
     }
 
-    bool isRightAssociative(const Token &token)
+    int getPrecedence(const Token &token)
     {
-        static const std::set<std::string> rightAssoc = {
-            "=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=", "^=", "|=", "?", ":"
-        };
-        return rightAssoc.count(token.value) > 0 || token.type == TokenType::UNARY_OPERATOR;
+        return token.precedence;
     }
 
-    SymbolDescriptor evalUnaryOperator(const SymbolDescriptor &operand, const std::string &op)
+    bool isRightAssociative(const Token &token)
     {
-        if (op == "-")
+        if (token.type == TokenType::UNARY_OPERATOR)
         {
-            return -operand;
+            return true;
         }
-        else if (op == "+")
+        switch (token.op)
         {
-            return operand;
+        case Opcode::ASSIGN:
+        case Opcode::ADD_ASSIGN:
+        case Opcode::SUB_ASSIGN:
+        case Opcode::MUL_ASSIGN:
+        case Opcode::DIV_ASSIGN:
+        case Opcode::MOD_ASSIGN:
+        case Opcode::AND_ASSIGN:
+        case Opcode::OR_ASSIGN:
+        case Opcode::XOR_ASSIGN:
+        case Opcode::SHL_ASSIGN:
+        case Opcode::SHR_ASSIGN:
+        case Opcode::CONDITIONAL:
+            return true;
+        default:
+            return false;
         }
-        else if (op == "*")
+    }
+
+    const char *opcodeName(Opcode op)
+    {
+        switch (op)
         {
-            return operand.dereference();
+        case Opcode::ADD: return "+";
+        case Opcode::SUB: return "-";
+        case Opcode::MUL: return "*";
+        case Opcode::DIV: return "/";
+        case Opcode::MOD: return "%";
+        case Opcode::BIT_AND: return "&";
+        case Opcode::BIT_OR: return "|";
+        case Opcode::BIT_XOR: return "^";
+        case Opcode::BIT_NOT: return "~";
+        case Opcode::SHL: return "<<";
+        case Opcode::SHR: return ">>";
+        case Opcode::LOGICAL_AND: return "&&";
+        case Opcode::LOGICAL_OR: return "||";
+        case Opcode::LOGICAL_NOT: return "!";
+        case Opcode::EQ: return "==";
+        case Opcode::NE: return "!=";
+        case Opcode::LT: return "<";
+        case Opcode::GT: return ">";
+        case Opcode::LE: return "<=";
+        case Opcode::GE: return ">=";
+        case Opcode::ASSIGN: return "=";
+        case Opcode::ADD_ASSIGN: return "+=";
+        case Opcode::SUB_ASSIGN: return "-=";
+        case Opcode::MUL_ASSIGN: return "*=";
+        case Opcode::DIV_ASSIGN: return "/=";
+        case Opcode::MOD_ASSIGN: return "%=";
+        case Opcode::AND_ASSIGN: return "&=";
+        case Opcode::OR_ASSIGN: return "|=";
+        case Opcode::XOR_ASSIGN: return "^=";
+        case Opcode::SHL_ASSIGN: return "<<=";
+        case Opcode::SHR_ASSIGN: return ">>=";
+        case Opcode::MEMBER: return ".";
+        case Opcode::PTR_MEMBER: return "->";
+        case Opcode::INDEX: return "[]";
+        case Opcode::CONDITIONAL: return "?";
+        case Opcode::COLON: return ":";
+        case Opcode::COMMA: return ",";
+        case Opcode::LPAREN: return "(";
+        case Opcode::RPAREN: return ")";
+        case Opcode::LBRACKET: return "[";
+        case Opcode::RBRACKET: return "]";
+        default: return "<none>";
         }
-        else if (op == "&")
+    }
+
+    SymbolDescriptor evalUnaryOperator(SymbolDescriptor &operand, Opcode op)
+    {
+        switch (op)
         {
+        case Opcode::SUB:
+            return -operand;
+        case Opcode::ADD:
+            return std::move(operand);
+        case Opcode::MUL:
+            return operand.dereference();
+        case Opcode::BIT_AND:
             return operand.addressOf();
+        case Opcode::LOGICAL_NOT:
+            return !operand;
+        case Opcode::BIT_NOT:
+            return ~operand;
+        default:
+            break;
         }
-        throw std::runtime_error("Unsupported unary operator: " + op);
+        throw std::runtime_error(std::string("Unsupported unary operator: ") + opcodeName(op));
     }
 
-    SymbolDescriptor evalBinaryOperator(SymbolDescriptor &left, const SymbolDescriptor &right, const std::string &op)
+    SymbolDescriptor evalBinaryOperator(SymbolDescriptor &left, SymbolDescriptor &right, Opcode op)
     {
-        if (op == "=")
+        switch (op)
         {
+        case Opcode::COMMA:
+            return std::move(right);
+        case Opcode::ASSIGN:
             return left.assign(right);
-        }
-        else if (op == "+=")
-        {
+        case Opcode::ADD_ASSIGN:
             return left.assign(left + right);
+        case Opcode::SUB_ASSIGN:
+            return left.assign(left - right);
+        case Opcode::MUL_ASSIGN:
+            return left.assign(left * right);
+        case Opcode::DIV_ASSIGN:
+            return left.assign(left / right);
+        case Opcode::MOD_ASSIGN:
+            return left.assign(left % right);
+        case Opcode::AND_ASSIGN:
+            return left.assign(left & right);
+        case Opcode::OR_ASSIGN:
+            return left.assign(left | right);
+        case Opcode::XOR_ASSIGN:
+            return left.assign(left ^ right);
+        case Opcode::SHL_ASSIGN:
+            return left.assign(left << right);
+        case Opcode::SHR_ASSIGN:
+            return left.assign(left >> right);
+        default:
+            return evalArithmeticOperator(left, right, op);
         }
-        else if (op == "-=")
+    }
+
+    SymbolDescriptor evalArithmeticOperator(const SymbolDescriptor &left, const SymbolDescriptor &right, Opcode op)
+    {
+        switch (op)
         {
-            return left.assign(left - right);
+        case Opcode::ADD:
+            return left + right;
+        case Opcode::SUB:
+            return left - right;
+        case Opcode::MUL:
+            return left * right;
+        case Opcode::DIV:
+            return left / right;
+        case Opcode::MOD:
+            return left % right;
+        case Opcode::BIT_AND:
+            return left & right;
+        case Opcode::BIT_OR:
+            return left | right;
+        case Opcode::BIT_XOR:
+            return left ^ right;
+        case Opcode::SHL:
+            return left << right;
+        case Opcode::SHR:
+            return left >> right;
+        case Opcode::LOGICAL_AND:
+            return left && right;
+        case Opcode::LOGICAL_OR:
+            return left || right;
+        case Opcode::EQ:
+            return left == right;
+        case Opcode::NE:
+            return left != right;
+        case Opcode::LT:
+            return left < right;
+        case Opcode::LE:
+            return left <= right;
+        case Opcode::GT:
+            return left > right;
+        case Opcode::GE:
+            return left >= right;
+        case Opcode::INDEX:
+            return evalArrayAccess(left, right);
+        case Opcode::COMMA:
+            return right;
+        default:
+            break;
         }
-        else if (op == "*=")
+        throw std::runtime_error(std::string("Unsupported binary operator: ") + opcodeName(op));
+    }
+
+    SymbolDescriptor evalArrayAccess(const SymbolDescriptor &array, const SymbolDescriptor &index)
+    {
+        if (array.cType[0] != CType::Type::POINTER && array.cType[0] != CType::Type::ARRAY)
         {
-            return left.assign(left * right);
+            throw std::runtime_error("Cannot index a non-array type");
         }
-        else if (op == "/=")
+        int idx = index.toUnsigned();
+        return array.dereference(idx);
+    }
+
+    SymbolDescriptor evalMemberAccess(const SymbolDescriptor &structOrPointer, const std::string &member, bool isPointerAccess)
+    {
+        if (isPointerAccess && structOrPointer.cType[0] != CType::Type::POINTER)
         {
-            return left.assign(left / right);
+            throw std::runtime_error("Expected a pointer for '->' operator");
         }
-        else if (op == "%=")
+        if (isPointerAccess)
         {
-            return left.assign(left % right);
+            return structOrPointer.dereference().getMember(member);
         }
-        else if (op == "&=")
+        return structOrPointer.getMember(member);
+    }
+
+    BinaryOpNode::BinaryOpNode(Opcode op, ASTNode *lhs, ASTNode *rhs)
+        : op(op), left(lhs), right(rhs) {}
+
+    SymbolDescriptor BinaryOpNode::evaluate() const
+    {
+        SymbolDescriptor lhsVal = left->evaluate();
+        if (op == Opcode::MEMBER || op == Opcode::PTR_MEMBER)
         {
-            return left.assign(left & right);
+            // the parser guarantees the right side is the member name
+            const auto &member = static_cast<const SymbolNode &>(*right);
+            return evalMemberAccess(lhsVal, member.name, op == Opcode::PTR_MEMBER);
         }
-        else if (op == "|=")
+        SymbolDescriptor rhsVal = right->evaluate();
+
+        return evalBinaryOperator(lhsVal, rhsVal, op);
+    }
+
+    void BinaryOpNode::compile(BytecodeProgram &program) const
+    {
+        left->compile(program);
+        if (op == Opcode::MEMBER || op == Opcode::PTR_MEMBER)
         {
-            return left.assign(left | right);
+            const auto &member = static_cast<const SymbolNode &>(*right);
+            program.emit(op == Opcode::MEMBER ? BytecodeOp::MEMBER : BytecodeOp::PTR_MEMBER, op, program.addName(member.name));
+            return;
         }
-        else if (op == "^=")
+        right->compile(program);
+        program.emit(op == Opcode::INDEX ? BytecodeOp::INDEX : BytecodeOp::BINARY, op);
+    }
+
+    static bool isAssignment(Opcode op)
+    {
+        return op >= Opcode::ASSIGN && op <= Opcode::SHR_ASSIGN;
+    }
+
+    static bool constantEquals(const SymbolDescriptor &value, uint64_t n)
+    {
+        if (!value.cType.empty() && (value.cType[0] == CType::Type::FLOAT || value.cType[0] == CType::Type::DOUBLE))
         {
-            return left.assign(left ^ right);
+            return value.toDouble() == static_cast<double>(n);
         }
-        else if (op == "<<=")
+        return value.toUnsigned() == n;
+    }
+
+    static bool isFloatingConstant(const SymbolDescriptor &value)
+    {
+        return !value.cType.empty() && (value.cType[0] == CType::Type::FLOAT || value.cType[0] == CType::Type::DOUBLE);
+    }
+
+    // x op c == x, for the constant c on the right
+    static bool isRightIdentity(Opcode op, const SymbolDescriptor &c)
+    {
+        switch (op)
         {
-            return left.assign(left << right);
+        case Opcode::ADD:
+        case Opcode::SUB:
+            return constantEquals(c, 0);
+        case Opcode::MUL:
+        case Opcode::DIV:
+            return constantEquals(c, 1);
+        case Opcode::BIT_OR:
+        case Opcode::BIT_XOR:
+            return !isFloatingConstant(c) && constantEquals(c, 0);
+        default:
+            return false;
         }
-        else if (op == ">>=")
+    }
+
+    // c op x == x, for the constant c on the left
+    static bool isLeftIdentity(Opcode op, const SymbolDescriptor &c)
+    {
+        switch (op)
         {
-            return left.assign(left >> right);
+        case Opcode::ADD:
+            return constantEquals(c, 0);
+        case Opcode::MUL:
+            return constantEquals(c, 1);
+        case Opcode::BIT_OR:
+        case Opcode::BIT_XOR:
+            return !isFloatingConstant(c) && constantEquals(c, 0);
+        default:
+            return false;
         }
-        return evalArithmeticOperator(left, right, op);
     }
 
-    SymbolDescriptor evalArithmeticOperator(const SymbolDescriptor &left, const SymbolDescriptor &right, const std::string &op)
+    // Returns a literal holding the value of 'node', errors are left for evaluation time.
+    static ASTNode *foldConstant(ASTNode *node, ASTArena &arena)
     {
-        if (op == "+")
+        try
         {
-            return left + right;
+            return arena.make<LiteralNode>(node->evaluate());
         }
-        else if (op == "-")
+        catch (const std::exception &)
         {
-            return left - right;
+            return node;
         }
-        else if (op == "*")
+    }
+
+    ASTNode *BinaryOpNode::optimize(ASTArena &arena)
+    {
+        left = left->optimize(arena);
+        if (op == Opcode::MEMBER || op == Opcode::PTR_MEMBER)
         {
-            return left * right;
+            return this;
         }
-        else if (op == "/")
+        right = right->optimize(arena);
+        if (isAssignment(op) || op == Opcode::INDEX)
         {
-            return left / right;
+            return this;
         }
-        else if (op == "%")
+
+        const SymbolDescriptor *lhs = left->constant();
+        const SymbolDescriptor *rhs = right->constant();
+        if (lhs && rhs)
         {
-            return left % right;
+            return foldConstant(this, arena);
         }
-        else if (op == "&")
+        else if (rhs && isRightIdentity(op, *rhs))
         {
-            return left & right;
+            return arena.make<PromoteNode>(left, *rhs, false, op);
         }
-        else if (op == "|")
+        else if (lhs && isLeftIdentity(op, *lhs))
         {
-            return left | right;
+            return arena.make<PromoteNode>(right, *lhs, true, op);
         }
-        else if (op == "^")
+        return this;
+    }
+
+    DbgData *ASTNode::data = nullptr;
+
+    ASTArena::~ASTArena()
+    {
+        for (auto it = nodes.rbegin(); it != nodes.rend(); ++it)
         {
-            return left ^ right;
+            (*it)->~ASTNode();
         }
-        else if (op == "<<")
+    }
+
+    void *ASTArena::allocate(size_t size, size_t align)
+    {
+        // blocks come from operator new[], so they are aligned for any node type
+        if (!blocks.empty())
         {
-            return left << right;
+            Block &block = blocks.back();
+            size_t offset = (block.used + align - 1) & ~(align - 1);
+            if (offset + size <= block.size)
+            {
+                block.used = offset + size;
+                return block.data.get() + offset;
+            }
         }
-        else if (op == ">>")
+        size_t blockSize = std::max(BLOCK_SIZE, size);
+        blocks.push_back({std::unique_ptr<std::byte[]>(new std::byte[blockSize]), blockSize, size});
+        return blocks.back().data.get();
+    }
+
+    const std::string &ASTArena::intern(std::string_view str)
+    {
+        for (const std::string &interned : strings)
         {
-            return left >> right;
+            if (interned == str)
+            {
+                return interned;
+            }
         }
-        else if (op == "&&")
+        return strings.emplace_back(str);
+    }
+
+    UnaryOpNode::UnaryOpNode(Opcode op, ASTNode *operand)
+        : op(op), operand(operand) {}
+
+    SymbolDescriptor UnaryOpNode::evaluate() const
+    {
+        SymbolDescriptor value = operand->evaluate();
+
+        return evalUnaryOperator(value, op);
+    }
+
+    ASTNode *UnaryOpNode::optimize(ASTArena &arena)
+    {
+        operand = operand->optimize(arena);
+        if (operand->constant() && op != Opcode::MUL && op != Opcode::BIT_AND)
         {
-            return left && right;
+            return foldConstant(this, arena);
         }
-        else if (op == "||")
+        return this;
+    }
+
+    void UnaryOpNode::compile(BytecodeProgram &program) const
+    {
+        operand->compile(program);
+        switch (op)
         {
-            return left || right;
+        case Opcode::MUL:
+            program.emit(BytecodeOp::DEREF, op);
+            break;
+        case Opcode::BIT_AND:
+            program.emit(BytecodeOp::ADDRESS_OF, op);
+            break;
+        default:
+            program.emit(BytecodeOp::UNARY, op);
+            break;
         }
-        else if (op == "==")
+    }
+
+    LiteralNode::LiteralNode(SymbolDescriptor val) : value(std::move(val)) {}
+
+    SymbolDescriptor LiteralNode::evaluate() const
+    {
+        return value;
+    }
+
+    void LiteralNode::compile(BytecodeProgram &program) const
+    {
+        program.emit(BytecodeOp::PUSH_CONST, Opcode::NONE, program.addConstant(value));
+    }
+
+    SymbolNode::SymbolNode(const std::string &name)
+        : name(name) {}
+
+    SymbolDescriptor SymbolNode::evaluate() const
+    {
+        return data->getSymbol(name);
+    }
+
+    void SymbolNode::compile(BytecodeProgram &program) const
+    {
+        program.emit(BytecodeOp::LOAD_SYMBOL, Opcode::NONE, program.addName(name));
+    }
+
+    CastNode::CastNode(CastType type, ASTNode *expr)
+            : type(std::move(type)), expression(expr) {}
+
+    SymbolDescriptor CastNode::evaluate() const
+    {
+        return evalCast(expression->evaluate(), type);
+    }
+
+    void CastNode::compile(BytecodeProgram &program) const
+    {
+        expression->compile(program);
+        program.emit(BytecodeOp::CAST, Opcode::NONE, program.addCastType(type));
+    }
+
+    ASTNode *CastNode::optimize(ASTArena &arena)
+    {
+        expression = expression->optimize(arena);
+        if (expression->constant())
         {
-            return left == right;
+            return foldConstant(this, arena);
         }
-        else if (op == "!=")
+        return this;
+    }
+
+    static SymbolDescriptor boolValue(bool val)
+    {
+        SymbolDescriptor result;
+        result.fromBool(val);
+        return result;
+    }
+
+    LogicalNode::LogicalNode(Opcode op, ASTNode *lhs, ASTNode *rhs)
+        : op(op), left(lhs), right(rhs) {}
+
+    SymbolDescriptor LogicalNode::evaluate() const
+    {
+        bool lhs = left->evaluate().toBool();
+        if (op == Opcode::LOGICAL_AND ? !lhs : lhs)
         {
-            return left != right;
+            return boolValue(lhs);
         }
-        else if (op == "<")
+        return boolValue(right->evaluate().toBool());
+    }
+
+    void LogicalNode::compile(BytecodeProgram &program) const
+    {
+        left->compile(program);
+        program.emit(BytecodeOp::TO_BOOL, op);
+        uint16_t skip = program.label();
+        program.emit(op == Opcode::LOGICAL_AND ? BytecodeOp::JUMP_IF_FALSE : BytecodeOp::JUMP_IF_TRUE, op);
+        program.emit(BytecodeOp::POP, op);
+        right->compile(program);
+        program.emit(BytecodeOp::TO_BOOL, op);
+        program.patch(skip, program.label());
+    }
+
+    ASTNode *LogicalNode::optimize(ASTArena &arena)
+    {
+        left = left->optimize(arena);
+        right = right->optimize(arena);
+        const SymbolDescriptor *lhs = left->constant();
+        if (lhs == nullptr)
         {
-            return left < right;
+            return this;
         }
-        else if (op == "<=")
+        bool decided = op == Opcode::LOGICAL_AND ? !lhs->toBool() : lhs->toBool();
+        if (decided || right->constant())
         {
-            return left <= right;
+            return foldConstant(this, arena);
         }
-        else if (op == ">")
+        return this;
+    }
+
+    ConditionalNode::ConditionalNode(ASTNode *cond, ASTNode *lhs, ASTNode *rhs)
+        : condition(cond), whenTrue(lhs), whenFalse(rhs) {}
+
+    SymbolDescriptor ConditionalNode::evaluate() const
+    {
+        if (condition->evaluate().toBool())
         {
-            return left > right;
+            return whenTrue->evaluate();
         }
-        else if (op == ">=")
+        return whenFalse->evaluate();
+    }
+
+    void ConditionalNode::compile(BytecodeProgram &program) const
+    {
+        condition->compile(program);
+        uint16_t toFalse = program.label();
+        program.emit(BytecodeOp::BRANCH_IF_FALSE, Opcode::CONDITIONAL);
+        size_t depth = program.stackDepth();
+        whenTrue->compile(program);
+        uint16_t toEnd = program.label();
+        program.emit(BytecodeOp::JUMP, Opcode::CONDITIONAL);
+        program.setStackDepth(depth);
+        program.patch(toFalse, program.label());
+        whenFalse->compile(program);
+        program.patch(toEnd, program.label());
+    }
+
+    ASTNode *ConditionalNode::optimize(ASTArena &arena)
+    {
+        condition = condition->optimize(arena);
+        whenTrue = whenTrue->optimize(arena);
+        whenFalse = whenFalse->optimize(arena);
+        const SymbolDescriptor *cond = condition->constant();
+        if (cond)
         {
-            return left >= right;
+            return cond->toBool() ? whenTrue : whenFalse;
         }
-        else if (op == "[]")
+        return this;
+    }
+
+    PromoteNode::PromoteNode(ASTNode *operand, SymbolDescriptor other, bool constantOnLeft, Opcode op)
+        : operand(operand), other(std::move(other)), constantOnLeft(constantOnLeft), op(op) {}
+
+    SymbolDescriptor PromoteNode::evaluate() const
+    {
+        return evalPromote(operand->evaluate(), other, constantOnLeft, op);
+    }
+
+    void PromoteNode::compile(BytecodeProgram &program) const
+    {
+        operand->compile(program);
+        program.emit(constantOnLeft ? BytecodeOp::PROMOTE_LEFT : BytecodeOp::PROMOTE, op, program.addConstant(other));
+    }
+
+    ASTNode *PromoteNode::optimize(ASTArena &arena)
+    {
+        operand = operand->optimize(arena);
+        return this;
+    }
+
+    // Read set analysis. Locations are resolved the way evaluation would, but
+    // only where that does not touch target memory. Symbols are looked up in
+    // the current scope, so the set is built again for every evaluation;
+    // stack and register symbols move with the frame and are left out.
+
+    // Pointer or array value usable as a base without reading memory.
+    static bool staticBase(const ASTNode *node, SymbolDescriptor &base)
+    {
+        if (const SymbolDescriptor *value = node->constant())
         {
-            return evalArrayAccess(left, right);
+            base = *value;
         }
-        else if (op == "." || op == "->")
+        else if (!node->staticLocation(base))
         {
-            return evalMemberAccess(left, right.name, op == "->");
+            return false;
         }
-        throw std::runtime_error("Unsupported binary operator: " + op);
+        return !base.cType.empty() && !base.hasAddress && !base.stack && base.regs.empty() &&
+               (base.cType[0] == CType::Type::POINTER || base.cType[0] == CType::Type::ARRAY);
     }
 
-    SymbolDescriptor evalArrayAccess(const SymbolDescriptor &array, const SymbolDescriptor &index)
+    // Adds the memory 'node' reads if its location is static, returns whether it was.
+    static bool addStaticRead(const ASTNode *node, std::vector<AddressRange> &reads)
     {
-        if (array.cType[0] != CType::Type::POINTER && array.cType[0] != CType::Type::ARRAY)
+        SymbolDescriptor loc;
+        if (!node->staticLocation(loc))
         {
-            throw std::runtime_error("Cannot index a non-array type");
+            return false;
         }
-        int idx = index.toUnsigned();
-        return array.dereference(idx);
+        if (loc.hasAddress && !loc.stack && loc.regs.empty() && !loc.cType.empty() &&
+            loc.cType[0] != CType::Type::ARRAY && loc.cType[0] != CType::Type::STRUCT &&
+            loc.cType[0] != CType::Type::UNION)
+        {
+            uint8_t size = ASTNode::data->sizeOf(loc.cType[0]);
+            if (size > 0)
+            {
+                reads.push_back({loc.value, size, loc.space});
+            }
+        }
+        return true;
     }
 
-    SymbolDescriptor evalMemberAccess(const SymbolDescriptor &structOrPointer, const std::string &member, bool isPointerAccess)
+    bool BinaryOpNode::staticLocation(SymbolDescriptor &out) const
     {
-        if (isPointerAccess && structOrPointer.cType[0] != CType::Type::POINTER)
+        SymbolDescriptor base;
+        try
         {
-            throw std::runtime_error("Expected a pointer for '->' operator");
+            if (op == Opcode::MEMBER)
+            {
+                if (!left->staticLocation(base))
+                {
+                    return false;
+                }
+                out = evalMemberAccess(base, static_cast<const SymbolNode &>(*right).name, false);
+                return true;
+            }
+            if (op == Opcode::INDEX)
+            {
+                const SymbolDescriptor *index = right->constant();
+                if (!index || !staticBase(left, base))
+                {
+                    return false;
+                }
+                out = evalArrayAccess(base, *index);
+                return true;
+            }
         }
-        const SymbolDescriptor &baseStruct = isPointerAccess ? structOrPointer.dereference() : structOrPointer;
-        return baseStruct.getMember(member);
+        catch (const std::exception &)
+        {
+            // left for evaluation to report
+        }
+        return false;
     }
 
-    BinaryOpNode::BinaryOpNode(std::string op, std::unique_ptr<ASTNode> lhs, std::unique_ptr<ASTNode> rhs)
-        : op(std::move(op)), left(std::move(lhs)), right(std::move(rhs)) {}
+    void BinaryOpNode::collectReads(std::vector<AddressRange> &reads) const
+    {
+        if (addStaticRead(this, reads))
+        {
+            return;
+        }
+        left->collectReads(reads);
+        if (op != Opcode::MEMBER && op != Opcode::PTR_MEMBER)
+        {
+            right->collectReads(reads);
+        }
+    }
 
-    SymbolDescriptor BinaryOpNode::evaluate()
+    bool UnaryOpNode::staticLocation(SymbolDescriptor &out) const
     {
-        SymbolDescriptor lhsVal = left->evaluate();
-        SymbolDescriptor rhsVal = right->evaluate();
+        SymbolDescriptor base;
+        if (op != Opcode::MUL || !staticBase(operand, base))
+        {
+            return false;
+        }
+        try
+        {
+            out = base.dereference();
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
 
-        return evalBinaryOperator(lhsVal, rhsVal, op);
+    void UnaryOpNode::collectReads(std::vector<AddressRange> &reads) const
+    {
+        if (addStaticRead(this, reads))
+        {
+            return;
+        }
+        SymbolDescriptor loc;
+        if (op == Opcode::BIT_AND && operand->staticLocation(loc))
+        {
+            return; // taking the address does not read the operand
+        }
+        operand->collectReads(reads);
     }
 
-    DbgData *ASTNode::data = nullptr;
+    bool SymbolNode::staticLocation(SymbolDescriptor &out) const
+    {
+        try
+        {
+            out = data->getSymbol(name);
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+        return !out.stack && out.regs.empty();
+    }
 
-    UnaryOpNode::UnaryOpNode(std::string op, std::unique_ptr<ASTNode> operand)
-        : op(std::move(op)), operand(std::move(operand)) {}
+    void SymbolNode::collectReads(std::vector<AddressRange> &reads) const
+    {
+        addStaticRead(this, reads);
+    }
 
-    SymbolDescriptor UnaryOpNode::evaluate()
+    void CastNode::collectReads(std::vector<AddressRange> &reads) const
     {
-        SymbolDescriptor value = operand->evaluate();
+        expression->collectReads(reads);
+    }
 
-        return evalUnaryOperator(value, op);
+    // The right operand and the branches may be skipped, only what is always
+    // evaluated is read up front.
+    void LogicalNode::collectReads(std::vector<AddressRange> &reads) const
+    {
+        left->collectReads(reads);
     }
 
-    LiteralNode::LiteralNode(SymbolDescriptor val) : value(std::move(val)) {}
+    void ConditionalNode::collectReads(std::vector<AddressRange> &reads) const
+    {
+        condition->collectReads(reads);
+    }
 
-    SymbolDescriptor LiteralNode::evaluate()
+    void PromoteNode::collectReads(std::vector<AddressRange> &reads) const
     {
-        return value;
+        operand->collectReads(reads);
     }
 
-    SymbolNode::SymbolNode(std::string name)
-        : name(std::move(name)) {}
+    SymbolDescriptor evalPromote(const SymbolDescriptor &operand, const SymbolDescriptor &other, bool constantOnLeft, Opcode op)
+    {
+        bool bitwise = op == Opcode::BIT_OR || op == Opcode::BIT_XOR;
+        if (constantOnLeft)
+        {
+            return other.applyIdentity(operand, true, bitwise);
+        }
+        return operand.applyIdentity(other, false, bitwise);
+    }
 
-    SymbolDescriptor SymbolNode::evaluate()
+    SymbolDescriptor evalCast(const SymbolDescriptor &original, const CastType &type)
     {
-        return data->getSymbol(name);
+        Value source = original.rvalue();
+        Value result{0, type.cType, type.isSigned};
+
+        switch (type.conversion)
+        {
+        case CastType::Conversion::POINTER:
+            result.bits = source.toUnsigned();
+            if (!source.type.empty() && source.type[0] == CType::Type::POINTER &&
+                result.type[0].space == AddressSpace::UNDEFINED)
+            {
+                result.type = type.cType.inner().pointerTo(source.type[0].space); // keep pointing into the same space
+            }
+            break;
+        case CastType::Conversion::INTEGER:
+        {
+            uint64_t val = source.isSigned ? (uint64_t)source.toSigned() : source.toUnsigned();
+            if (type.size > 0 && type.size < 8)
+            {
+                unsigned bits = type.size * 8;
+                val &= (uint64_t(1) << bits) - 1;
+                if (type.isSigned && (val >> (bits - 1)) & 1)
+                {
+                    val |= ~uint64_t(0) << bits; // sign extend
+                }
+            }
+            result.bits = val;
+            break;
+        }
+        case CastType::Conversion::FLOAT:
+            result.bits = std::bit_cast<uint32_t>(source.toFloat());
+            break;
+        case CastType::Conversion::DOUBLE:
+            result.bits = std::bit_cast<uint64_t>(source.toDouble());
+            break;
+        case CastType::Conversion::BOOL:
+            result.bits = source.toBool() ? 1 : 0;
+            break;
+        }
+
+        return SymbolDescriptor(result);
     }
-    CastNode::CastNode(const std::string& type, std::unique_ptr<ASTNode> expr)
-            : typeName(type), expression(std::move(expr)) {}
 
-    SymbolDescriptor CastNode::evaluate()
+    bool isBaseTypeName(std::string_view name)
     {
-        SymbolDescriptor original = expression->evaluate();
+        static constexpr std::string_view baseTypes[] = {
+            "void", "bool", "_Bool", "char", "short", "int", "long", "float", "double",
+            "signed", "unsigned", "struct", "union", "const", "volatile"
+        };
+        for (std::string_view type : baseTypes)
+        {
+            if (type == name)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
 
-        bool isUnsigned = false;
-        std::vector<CType> newType = CType::parseCTypeVector(typeName, isUnsigned);
-        if (newType.empty())
-            throw std::runtime_error("Invalid cast type: " + typeName);
-            
-        SymbolDescriptor result;
-        result.hasAddress = false;
-        result.cType = newType;
-        result.isSigned = !isUnsigned;
-        
-        CType::Type targetBaseType = newType.back().type;
-        // CType::Type sourceBaseType;
-        // if (original.cType.empty())
-        // {
-        //     sourceBaseType == CType::Type::UNKNOWN;
-        // }
-        // else
-        // {
-        //     sourceBaseType = original.cType.back().type;
-        // }
-
-        if (newType.begin()->type == CType::Type::POINTER)
-        {
-            result.value = original.value;
-            return result;
-        }
-
-        switch (targetBaseType)
-        {
-            case CType::Type::INT:
-            case CType::Type::LONG:
-            case CType::Type::LONGLONG:
-                result.value = original.toUnsigned();
-                break;
-            case CType::Type::FLOAT:
-                result.value = original.toFloat();
-                break;
-            case CType::Type::DOUBLE:
-                result.value = original.toDouble();
-                break;
-            case CType::Type::POINTER:
-                result.value = original.toUnsigned();
-                result.hasAddress = true;
-                break;
-            case CType::Type::BOOL:
-                result.value = original.toUnsigned();
-                break;
-            default:
-                throw std::runtime_error("Unsupported cast to type: " + typeName);
+    bool ExpressionParser::isTypeName(std::string_view name) const
+    {
+        if (isBaseTypeName(name))
+        {
+            return true;
         }
+        return debuggerData != nullptr && debuggerData->isTypeName(std::string(name));
+    }
 
-        return result;
+    bool ExpressionParser::isCastAhead() const
+    {
+        // tokens[index] is the '('
+        size_t i = index + 1;
+        if (i >= tokens.size() || tokens[i].type != TokenType::SYMBOL || !isTypeName(tokens[i].value))
+        {
+            return false;
+        }
+        for (; i < tokens.size(); i++)
+        {
+            if (tokens[i].op == Opcode::RPAREN)
+            {
+                return true;
+            }
+            if (tokens[i].type != TokenType::SYMBOL && tokens[i].op != Opcode::MUL && tokens[i].op != Opcode::BIT_AND)
+            {
+                return false;
+            }
+        }
+        return false;
     }
 
     std::string ExpressionParser::parseCastType() {
         std::string type;
-        while (index < tokens.size()) {
-            Token tok = tokens[index];
-    
-            if (tok.type == TokenType::PARENTHESIS && tok.value == ")")
-                break;
-    
-            if (tok.type == TokenType::SYMBOL || tok.value == "*" || tok.value == "&") {
-                if (!type.empty()) type += " ";
-                type += tok.value;
-                index++;
-            } else {
-                throw std::runtime_error("Invalid token in type cast: " + tok.value);
-            }
+        while (index < tokens.size() && tokens[index].op != Opcode::RPAREN) {
+            if (!type.empty()) type += " ";
+            type += tokens[index++].value;
         }
-    
-        if (type.empty())
-            throw std::runtime_error("Empty type cast");
-    
         return type;
     }
 
-    std::unique_ptr<ASTNode> ExpressionParser::parsePrimary()
+    ASTNode *ExpressionParser::parsePrimary()
     {
         if (index >= tokens.size())
             throw std::runtime_error("Unexpected end of input, index: " + std::to_string(index));
 
-        if (tokens[index].type == TokenType::PARENTHESIS && tokens[index].value == "(")
+        if (tokens[index].op == Opcode::LPAREN && isCastAhead())
         {
-            size_t savedIndex = index;
             index++; // consume '('
-
-            try {
-                std::string typeName = parseCastType(); // new function
-                if (index < tokens.size() && tokens[index].value == ")") {
-                    index++; // consume ')'
-                    auto castedExpr = parsePrimary(); // parse the expression being cast
-                    return std::make_unique<CastNode>(typeName, std::move(castedExpr));
-                }
-            } catch (...) {
-                index = savedIndex; // not a cast, rewind
-            }
-
-            // Regular parenthesized expression
-            index = savedIndex;
+            std::string typeName = parseCastType();
+            index++; // consume ')'
+            // the operand of a cast is a unary expression
+            auto castedExpr = parseExpression(UNARY_PRECEDENCE + 1);
+            return arena.make<CastNode>(CastType::resolve(typeName, debuggerData), castedExpr);
         }
 
         Token token = tokens[index++];
         if (token.type == TokenType::NUMBER)
         {
-            return std::make_unique<LiteralNode>(SymbolDescriptor(token.value));
+            return arena.make<LiteralNode>(SymbolDescriptor(token.literal));
         }
         else if (token.type == TokenType::SYMBOL)
         {
-            return std::make_unique<SymbolNode>(token.value);
+            return arena.make<SymbolNode>(arena.intern(token.value));
         }
-        else if (token.type == TokenType::PARENTHESIS && token.value == "(")
+        else if (token.op == Opcode::LPAREN)
         {
             auto expr = parseExpression(1);
-            if (index >= tokens.size() || (tokens[index].type != TokenType::PARENTHESIS && tokens[index].value != ")"))
+            if (index >= tokens.size() || tokens[index].op != Opcode::RPAREN)
             {
                 if (index >= tokens.size())
                 {
                     throw std::runtime_error("Expected closing parenthesis, index: " + std::to_string(index));
                 }
-                throw std::runtime_error("Expected closing parenthesis: " + tokens[index].value + ", index: " + std::to_string(index));
+                throw std::runtime_error("Expected closing parenthesis: " + std::string(tokens[index].value) + ", index: " + std::to_string(index));
             }
             ++index;
             return expr;
         }
-        throw std::runtime_error("Unexpected token in primary expression: " + token.value + ", index: " + std::to_string(index - 1));
+        throw std::runtime_error("Unexpected token in primary expression: " + std::string(token.value) + ", index: " + std::to_string(index - 1));
     }
 
-    std::unique_ptr<ASTNode> ExpressionParser::parseExpression(int minPrecedence)
+    ASTNode *ExpressionParser::parseExpression(int minPrecedence)
     {
         if (minPrecedence == 0)
         {
             minPrecedence = 1;
         }
-        std::unique_ptr<ASTNode> lhs;
+        ASTNode *lhs;
 
         if (index >= tokens.size())
             throw std::runtime_error("Unexpected end of input");
 
         Token token = tokens[index];
-        if (token.type == TokenType::UNARY_OPERATOR)
+        // After a cast's ')' the lexer sees + - * & as binary, but any operator in
+        // operand position is unary.
+        bool unaryInPosition = token.type == TokenType::OPERATOR &&
+                               (token.op == Opcode::ADD || token.op == Opcode::SUB ||
+                                token.op == Opcode::MUL || token.op == Opcode::BIT_AND);
+        if (token.type == TokenType::UNARY_OPERATOR || unaryInPosition)
         {
             index++; // Consume the operator
-            auto operand = parseExpression(getPrecedence(token) + 1);
-            lhs = std::make_unique<UnaryOpNode>(token.value, std::move(operand));
+            auto operand = parseExpression(UNARY_PRECEDENCE + 1);
+            lhs = arena.make<UnaryOpNode>(token.op, operand);
         }
         else
         {
@@ -659,17 +1359,57 @@ namespace CdbgExpr
             int precedence = getPrecedence(opToken);
             bool rightAssoc = isRightAssociative(opToken);
 
+            if (opToken.op == Opcode::LBRACKET)
+            {
+                auto subscript = parseExpression(1);
+                if (index >= tokens.size() || tokens[index].op != Opcode::RBRACKET)
+                {
+                    throw std::runtime_error("Expected closing bracket, index: " + std::to_string(index));
+                }
+                ++index;
+                lhs = arena.make<BinaryOpNode>(Opcode::INDEX, lhs, subscript);
+                continue;
+            }
+            if (opToken.op == Opcode::MEMBER || opToken.op == Opcode::PTR_MEMBER)
+            {
+                if (index >= tokens.size() || tokens[index].type != TokenType::SYMBOL)
+                {
+                    throw std::runtime_error("Expected member name, index: " + std::to_string(index));
+                }
+                auto member = arena.make<SymbolNode>(arena.intern(tokens[index++].value));
+                lhs = arena.make<BinaryOpNode>(opToken.op, lhs, member);
+                continue;
+            }
+
+            if (opToken.op == Opcode::CONDITIONAL)
+            {
+                auto whenTrue = parseExpression(1);
+                if (index >= tokens.size() || tokens[index].op != Opcode::COLON)
+                {
+                    throw std::runtime_error("Expected ':' in conditional expression, index: " + std::to_string(index));
+                }
+                ++index;
+                auto whenFalse = parseExpression(precedence);
+                lhs = arena.make<ConditionalNode>(lhs, whenTrue, whenFalse);
+                continue;
+            }
+
             auto rhs = parseExpression(precedence + (rightAssoc ? 0 : 1));
-            lhs = std::make_unique<BinaryOpNode>(opToken.value, std::move(lhs), std::move(rhs));
+            if (opToken.op == Opcode::LOGICAL_AND || opToken.op == Opcode::LOGICAL_OR)
+            {
+                lhs = arena.make<LogicalNode>(opToken.op, lhs, rhs);
+                continue;
+            }
+            lhs = arena.make<BinaryOpNode>(opToken.op, lhs, rhs);
         }
 
         return lhs;
     }
 
-    ExpressionParser::ExpressionParser(std::vector<Token> tokens, DbgData *debuggerData)
-        : tokens(std::move(tokens)), index(0), debuggerData(debuggerData) {}
+    ExpressionParser::ExpressionParser(std::vector<Token> tokens, DbgData *debuggerData, ASTArena &arena)
+        : tokens(std::move(tokens)), index(0), debuggerData(debuggerData), arena(arena) {}
 
-    std::unique_ptr<ASTNode> ExpressionParser::parse()
+    ASTNode *ExpressionParser::parse()
     {
         return parseExpression(1);
     }
@@ -0,0 +1,278 @@
+#include "SimulatedTarget.h"
+#include <stdexcept>
+#include <thread>
+
+namespace CdbgExpr
+{
+    SymbolDescriptor SimulatedTarget::getSymbol(const std::string &name)
+    {
+        auto it = symbols.find(name);
+        if (it == symbols.end())
+        {
+            SymbolDescriptor unknown;
+            unknown.name = name;
+            return unknown;
+        }
+        return it->second;
+    }
+
+    uint8_t SimulatedTarget::getByte(uint64_t addr)
+    {
+        uint8_t val;
+        readMemory(AddressSpace::UNDEFINED, addr, std::span<uint8_t>(&val, 1));
+        return val;
+    }
+
+    void SimulatedTarget::setByte(uint64_t addr, uint8_t val)
+    {
+        writeMemory(AddressSpace::UNDEFINED, addr, std::span<const uint8_t>(&val, 1));
+    }
+
+    void SimulatedTarget::readBlock(uint64_t addr, std::span<uint8_t> out)
+    {
+        readMemory(AddressSpace::UNDEFINED, addr, out);
+    }
+
+    void SimulatedTarget::writeBlock(uint64_t addr, std::span<const uint8_t> in)
+    {
+        writeMemory(AddressSpace::UNDEFINED, addr, in);
+    }
+
+    void SimulatedTarget::readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out)
+    {
+        stats_.readCalls++;
+        stats_.bytesRead += out.size();
+        transaction(out.size());
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            out[i] = readSpace(space, addr + i);
+        }
+    }
+
+    void SimulatedTarget::writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in)
+    {
+        stats_.writeCalls++;
+        stats_.bytesWritten += in.size();
+        transaction(in.size());
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            writeSpace(space, addr + i, in[i]);
+        }
+    }
+
+    uint8_t SimulatedTarget::CTypeSize(CType type)
+    {
+        // sizes as SDCC uses them for mcs51
+        switch (type.type)
+        {
+        case CType::Type::BOOL:
+        case CType::Type::CHAR:
+            return 1;
+        case CType::Type::SHORT:
+        case CType::Type::INT:
+            return 2;
+        case CType::Type::LONG:
+        case CType::Type::FLOAT:
+            return 4;
+        case CType::Type::LONGLONG:
+        case CType::Type::DOUBLE:
+            return 8;
+        case CType::Type::POINTER:
+            switch (type.space)
+            {
+            case AddressSpace::UNDEFINED:
+                return 3; // generic, space tag in the top byte
+            case AddressSpace::INTERNAL_RAM_LOW:
+            case AddressSpace::INTERNAL_RAM:
+            case AddressSpace::EXTERNAL_STACK:
+                return 1;
+            default:
+                return 2;
+            }
+        case CType::Type::STRUCT:
+        case CType::Type::UNION:
+        {
+            auto it = types.find(type.name);
+            return it != types.end() ? it->second : 0;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    uint64_t SimulatedTarget::getStackPointer()
+    {
+        stats_.stackPointerCalls++;
+        transaction(1);
+        return sfr[SFR_SP - 0x80];
+    }
+
+    uint8_t SimulatedTarget::getRegContent(uint8_t regNum)
+    {
+        stats_.registerCalls++;
+        transaction(1);
+        return idata[registerAddress(regNum)];
+    }
+
+    void SimulatedTarget::setRegContent(uint8_t regNum, uint8_t val)
+    {
+        stats_.registerCalls++;
+        transaction(1);
+        idata[registerAddress(regNum)] = val;
+    }
+
+    void SimulatedTarget::getRegisters(std::span<uint8_t> out)
+    {
+        stats_.registerCalls++;
+        transaction(out.size());
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            out[i] = idata[registerAddress(i)];
+        }
+    }
+
+    void SimulatedTarget::setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals)
+    {
+        stats_.registerCalls++;
+        transaction(regNums.size());
+        for (size_t i = 0; i < regNums.size() && i < vals.size(); i++)
+        {
+            idata[registerAddress(regNums[i])] = vals[i];
+        }
+    }
+
+    bool SimulatedTarget::isTypeName(const std::string &name)
+    {
+        return types.count(name) != 0;
+    }
+
+    void SimulatedTarget::addSymbol(const SymbolDescriptor &symbol)
+    {
+        symbols[symbol.name] = symbol;
+    }
+
+    std::shared_ptr<const StructLayout> SimulatedTarget::getLayout(const std::string &name)
+    {
+        auto it = layouts.find(name);
+        return it != layouts.end() ? it->second : nullptr;
+    }
+
+    void SimulatedTarget::addType(const std::string &name, uint8_t size, std::shared_ptr<const StructLayout> layout)
+    {
+        types[name] = size;
+        if (layout)
+        {
+            layouts[name] = std::move(layout);
+        }
+    }
+
+    void SimulatedTarget::load(AddressSpace space, uint64_t addr, std::span<const uint8_t> in)
+    {
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            writeSpace(space, addr + i, in[i]);
+        }
+    }
+
+    void SimulatedTarget::dump(AddressSpace space, uint64_t addr, std::span<uint8_t> out)
+    {
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            out[i] = readSpace(space, addr + i);
+        }
+    }
+
+    void SimulatedTarget::setRegisterBank(uint8_t bank)
+    {
+        uint8_t &psw = sfr[SFR_PSW - 0x80];
+        psw = (psw & ~0x18) | ((bank & 0x03) << 3);
+    }
+
+    void SimulatedTarget::transaction(size_t bytes)
+    {
+        std::chrono::nanoseconds cost = latency.perCall + latency.perByte * bytes;
+        stats_.transactions++;
+        stats_.elapsed += cost;
+        if (realTime && cost.count() > 0)
+        {
+            std::this_thread::sleep_for(cost);
+        }
+    }
+
+    uint8_t &SimulatedTarget::cell(AddressSpace space, uint64_t addr)
+    {
+        switch (space)
+        {
+        case AddressSpace::CODE:
+        case AddressSpace::CODE_STATIC:
+            if (addr < code.size())
+                return code[addr];
+            break;
+        case AddressSpace::UNDEFINED:
+        case AddressSpace::EXTERNAL_RAM:
+        case AddressSpace::EXTERNAL_STACK:
+            if (addr < xdata.size())
+                return xdata[addr];
+            break;
+        case AddressSpace::INTERNAL_RAM_LOW:
+        case AddressSpace::BIT_ADDRESSABLE:
+            if (addr < 0x80)
+                return idata[addr];
+            break;
+        case AddressSpace::INTERNAL_RAM:
+        case AddressSpace::INTERNAL_STACK:
+            if (addr < idata.size())
+                return idata[addr];
+            break;
+        case AddressSpace::SFR:
+            if (addr >= 0x80 && addr < 0x100)
+                return sfr[addr - 0x80];
+            break;
+        case AddressSpace::SBIT:
+            // bits 0x00 - 0x7F are in idata 0x20 - 0x2F, the others in the SFRs at multiples of 8
+            if (addr < 0x80)
+                return idata[0x20 + addr / 8];
+            if (addr < 0x100)
+                return sfr[(addr & 0xF8) - 0x80];
+            break;
+        case AddressSpace::REGISTER:
+            if (addr < 8)
+                return idata[registerAddress(addr)];
+            break;
+        }
+        throw std::runtime_error("Address out of range of the simulated target");
+    }
+
+    uint8_t SimulatedTarget::readSpace(AddressSpace space, uint64_t addr)
+    {
+        uint8_t val = cell(space, addr);
+        if (space == AddressSpace::SBIT)
+        {
+            return (val >> (addr & 7)) & 1;
+        }
+        return val;
+    }
+
+    void SimulatedTarget::writeSpace(AddressSpace space, uint64_t addr, uint8_t val)
+    {
+        uint8_t &byte = cell(space, addr);
+        if (space == AddressSpace::SBIT)
+        {
+            uint8_t mask = 1 << (addr & 7);
+            byte = val ? (byte | mask) : (byte & ~mask);
+            return;
+        }
+        byte = val;
+    }
+
+    uint8_t SimulatedTarget::registerAddress(uint8_t regNum) const
+    {
+        if (regNum >= 8)
+        {
+            throw std::runtime_error("Register number out of range");
+        }
+        uint8_t bank = (sfr[SFR_PSW - 0x80] >> 3) & 0x03;
+        return bank * 8 + regNum;
+    }
+
+} // namespace CdbgExpr
@@ -4,85 +4,626 @@
 #include <cstdint>
 #include <iostream>
 #include <vector>
+#include <charconv>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include "SymbolDescriptor.h"
-#include <regex>
 
 namespace CdbgExpr
 {
     DbgData *SymbolDescriptor::data = nullptr;
     bool SymbolDescriptor::assignmentAllowed = false;
 
+    void DbgData::readBlock(uint64_t addr, std::span<uint8_t> out)
+    {
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            out[i] = getByte(addr + i);
+        }
+    }
+
+    void DbgData::writeBlock(uint64_t addr, std::span<const uint8_t> in)
+    {
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            setByte(addr + i, in[i]);
+        }
+    }
+
+    void DbgData::getRegisters(std::span<uint8_t> out)
+    {
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            out[i] = getRegContent(i);
+        }
+    }
+
+    void DbgData::setRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals)
+    {
+        for (size_t i = 0; i < regNums.size() && i < vals.size(); i++)
+        {
+            setRegContent(regNums[i], vals[i]);
+        }
+    }
+
+    uint8_t DbgData::readRegister(uint8_t regNum)
+    {
+        if (!regSnapshotValid)
+        {
+            regSnapshotSize = registerCount();
+            getRegisters(std::span<uint8_t>(regSnapshot.data(), regSnapshotSize));
+            regSnapshotValid = true;
+        }
+        if (regNum >= regSnapshotSize)
+        {
+            // outside of the bulk range, ask the target directly
+            return getRegContent(regNum);
+        }
+        return regSnapshot[regNum];
+    }
+
+    void DbgData::writeRegisters(std::span<const uint8_t> regNums, std::span<const uint8_t> vals)
+    {
+        setRegisters(regNums, vals);
+        if (regSnapshotValid)
+        {
+            for (size_t i = 0; i < regNums.size() && i < vals.size(); i++)
+            {
+                regSnapshot[regNums[i]] = vals[i];
+            }
+        }
+    }
+
+    void DbgData::beginEvaluation()
+    {
+        if (!keepSnapshots)
+        {
+            invalidateRegisters();
+            if (!frameSelected)
+            {
+                frameValid = false;
+            }
+        }
+    }
+
+    const FrameContext &DbgData::frame()
+    {
+        if (!frameValid)
+        {
+            frameContext = captureFrame();
+            frameValid = true;
+        }
+        return frameContext;
+    }
+
+    FrameContext DbgData::captureFrame()
+    {
+        uint64_t sp = getStackPointer();
+        return FrameContext{sp, sp, 0};
+    }
+
+    void DbgData::selectFrame(const FrameContext &context)
+    {
+        frameContext = context;
+        frameValid = true;
+        frameSelected = true;
+    }
+
+    void DbgData::readMemory(AddressSpace space, uint64_t addr, std::span<uint8_t> out)
+    {
+        (void)space;
+        readBlock(addr, out);
+    }
+
+    void DbgData::writeMemory(AddressSpace space, uint64_t addr, std::span<const uint8_t> in)
+    {
+        (void)space;
+        writeBlock(addr, in);
+    }
+
+    AddressSpace addressSpaceFromCode(char code)
+    {
+        switch (code)
+        {
+        case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
+        case 'G': case 'H': case 'I': case 'J': case 'R':
+            return static_cast<AddressSpace>(code);
+        default:
+            return AddressSpace::UNDEFINED;
+        }
+    }
+
+    AddressSpace pointerSpaceFromCode(std::string_view declarator)
+    {
+        if (declarator == "DC")
+            return AddressSpace::CODE;
+        if (declarator == "DX")
+            return AddressSpace::EXTERNAL_RAM;
+        if (declarator == "DP")
+            return AddressSpace::EXTERNAL_STACK; // pdata, as for generic pointers
+        if (declarator == "DD")
+            return AddressSpace::INTERNAL_RAM_LOW;
+        if (declarator == "DI")
+            return AddressSpace::INTERNAL_RAM;
+        return AddressSpace::UNDEFINED;
+    }
+
+    // Address a pointer value refers to, and the space it is in. Three byte
+    // generic pointers carry the space in their top byte.
+    static uint64_t pointerTarget(const CType &pointer, uint64_t value, AddressSpace &space)
+    {
+        space = pointer.space;
+        if (space != AddressSpace::UNDEFINED || SymbolDescriptor::data->sizeOf(pointer) != 3)
+        {
+            return value;
+        }
+        switch ((value >> 16) & 0xFF)
+        {
+        case 0x00:
+            space = AddressSpace::EXTERNAL_RAM;
+            break;
+        case 0x40:
+            space = AddressSpace::INTERNAL_RAM;
+            break;
+        case 0x60:
+            space = AddressSpace::EXTERNAL_STACK; // pdata
+            break;
+        case 0x80:
+            space = AddressSpace::CODE;
+            break;
+        default:
+            return value;
+        }
+        return value & 0xFFFF;
+    }
+
+    // The loops have a constant trip count and compile down to plain loads and
+    // stores, with a byte swap where the order differs from the host.
+    template <size_t N, ByteOrder Order>
+    static uint64_t decodeFixed(const uint8_t *bytes)
+    {
+        uint64_t val = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            size_t shift = (Order == ByteOrder::LITTLE ? i : N - 1 - i) * 8;
+            val |= (uint64_t)bytes[i] << shift;
+        }
+        return val;
+    }
+
+    template <size_t N, ByteOrder Order>
+    static void encodeFixed(uint64_t val, uint8_t *bytes)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            size_t shift = (Order == ByteOrder::LITTLE ? i : N - 1 - i) * 8;
+            bytes[i] = (val >> shift) & 0xFF;
+        }
+    }
+
+    template <ByteOrder Order, size_t... N>
+    static constexpr std::array<ValueCodec, sizeof...(N)> makeCodecs(std::index_sequence<N...>)
+    {
+        return {ValueCodec{N, N, &decodeFixed<N, Order>, &encodeFixed<N, Order>}...};
+    }
+
+    static constexpr auto littleEndianCodecs = makeCodecs<ByteOrder::LITTLE>(std::make_index_sequence<9>());
+    static constexpr auto bigEndianCodecs = makeCodecs<ByteOrder::BIG>(std::make_index_sequence<9>());
+
+    ValueCodec ValueCodec::select(uint8_t size, ByteOrder order)
+    {
+        ValueCodec codec = (order == ByteOrder::LITTLE ? littleEndianCodecs : bigEndianCodecs)[std::min<uint8_t>(size, 8)];
+        codec.size = size;
+        return codec;
+    }
+
+    ValueCodec TargetModel::codec(DbgData &data, const CType &type)
+    {
+        if (shared_)
+        {
+            return shared_->codec(data, type);
+        }
+        ValueCodec *slot = nullptr;
+        switch (type.type)
+        {
+        case CType::Type::STRUCT:
+        case CType::Type::UNION:
+        case CType::Type::ARRAY:
+        case CType::Type::BITFIELD:
+            break;
+        case CType::Type::POINTER:
+            slot = &pointers[static_cast<uint8_t>(type.space)];
+            break;
+        default:
+            slot = &scalars[static_cast<size_t>(type.type)];
+            break;
+        }
+        if (slot && slot->decode)
+        {
+            return *slot;
+        }
+        ValueCodec codec = ValueCodec::select(data.CTypeSize(type), byteOrder);
+        if (slot)
+        {
+            *slot = codec;
+        }
+        return codec;
+    }
+
+    static uint64_t nextGeneration()
+    {
+        static uint64_t generations = 0;
+        return ++generations;
+    }
+
+    TargetModel::TargetModel()
+        : generation_(nextGeneration())
+    {
+    }
+
+    void TargetModel::reset()
+    {
+        if (shared_)
+        {
+            shared_->reset();
+            return;
+        }
+        scalars.fill(ValueCodec());
+        pointers.fill(ValueCodec());
+        generation_ = nextGeneration();
+    }
+
+    void TargetModel::share(TargetModel &target)
+    {
+        shared_ = target.shared_ ? target.shared_ : &target;
+        byteOrder = shared_->byteOrder;
+    }
+
     std::vector<CType> CType::parseCTypeVector(const std::string& typeStr, bool& isUnsigned)
     {
         std::vector<CType> result;
         std::istringstream iss(typeStr);
         std::string word;
-        bool lastWordLong = false;
+        size_t pointers = 0;
+        int longs = 0;
+        bool hasBase = false;
+        bool isTag = false;
+        CType base(CType::Type::INT);
 
         while (iss >> word)
         {
-            if (word == "*")
-            {
-                result.insert(result.begin(), CType(CType::Type::POINTER));
-            }
-            else if (word == "int")
+            if (isTag)
             {
-                result.push_back(CType(CType::Type::INT));
+                // struct/union tag name
+                base.name = word;
+                hasBase = true;
+                isTag = false;
             }
-            else if (word == "float")
+            else if (word == "*")
             {
-                result.push_back(CType(CType::Type::FLOAT));
+                pointers++;
             }
-            else if (word == "double")
+            else if (word == "struct" || word == "union")
             {
-                result.push_back(CType(CType::Type::DOUBLE));
+                base = CType(word == "struct" ? CType::Type::STRUCT : CType::Type::UNION);
+                isTag = true;
             }
-            else if (word == "char")
+            else if (word == "const" || word == "volatile" || word == "&")
             {
-                result.push_back(CType(CType::Type::CHAR));
+                continue;
             }
-            else if (word == "bool")
+            else if (word == "unsigned")
             {
-                result.push_back(CType(CType::Type::BOOL));
+                isUnsigned = true;
             }
-            else if (word == "void")
+            else if (word == "signed")
             {
-                result.push_back(CType(CType::Type::VOID_type));
+                isUnsigned = false;
             }
             else if (word == "long")
             {
-                if (lastWordLong)
+                longs++;
+                if (base.type != CType::Type::DOUBLE)
                 {
-                    result.push_back(CType(CType::Type::LONGLONG));
-                    lastWordLong = false;
+                    base = CType(longs > 1 ? CType::Type::LONGLONG : CType::Type::LONG);
                 }
-                else
+                hasBase = true;
+            }
+            else if (word == "int")
+            {
+                if (longs == 0 && base.type != CType::Type::SHORT && base.type != CType::Type::CHAR)
                 {
-                    lastWordLong = true;
+                    base = CType(CType::Type::INT);
                 }
-                continue;
+                hasBase = true;
             }
-            else if (word == "unsigned")
+            else if (word == "short")
             {
-                isUnsigned = true;
+                base = CType(CType::Type::SHORT);
+                hasBase = true;
             }
-            else if (word == "signed")
+            else if (word == "char")
             {
-                isUnsigned = false;
+                base = CType(CType::Type::CHAR);
+                hasBase = true;
+            }
+            else if (word == "bool" || word == "_Bool")
+            {
+                base = CType(CType::Type::BOOL);
+                hasBase = true;
+            }
+            else if (word == "float")
+            {
+                base = CType(CType::Type::FLOAT);
+                hasBase = true;
+            }
+            else if (word == "double")
+            {
+                base = CType(CType::Type::DOUBLE);
+                hasBase = true;
+            }
+            else if (word == "void")
+            {
+                base = CType(CType::Type::VOID_type);
+                hasBase = true;
             }
             else
             {
                 // Assume user-defined struct/union type
-                result.insert(result.begin(), CType(CType::Type::STRUCT, word));
+                base = CType(CType::Type::STRUCT, word);
+                hasBase = true;
             }
-            if (lastWordLong)
+        }
+
+        // a lone signed/unsigned is an int
+        if (!hasBase && typeStr.find("signed") == std::string::npos)
+        {
+            return result;
+        }
+        result.assign(pointers, CType(CType::Type::POINTER));
+        result.push_back(base);
+        return result;
+    }
+
+    // Interned type chain. Derived chains are linked once they have been asked
+    // for, so that walking types during evaluation does not hash.
+    struct TypeNode
+    {
+        std::vector<CType> chain;
+        const TypeNode *inner = nullptr;
+        mutable std::vector<std::pair<AddressSpace, const TypeNode *>> pointers;
+        mutable std::string names[2]; // by signedness, empty until built
+        mutable size_t byteSize = 0;
+        mutable uint64_t sizeGeneration = 0; // model generation byteSize is valid for
+    };
+
+    static bool sameType(const CType &a, const CType &b)
+    {
+        return a.type == b.type && a.offset == b.offset && a.size == b.size && a.space == b.space && a.name == b.name &&
+               a.layout == b.layout;
+    }
+
+    struct ChainHash
+    {
+        size_t operator()(const std::vector<CType> &chain) const
+        {
+            size_t hash = chain.size();
+            for (const CType &type : chain)
             {
-                result.push_back(CType(CType::Type::LONG));
-                lastWordLong = false;
+                size_t item = std::hash<std::string>()(type.name);
+                item ^= (static_cast<size_t>(type.type) << 1) ^ (static_cast<size_t>(type.space) << 8) ^ (type.size << 16) ^ static_cast<size_t>(type.offset);
+                item ^= std::hash<const StructLayout *>()(type.layout.get());
+                hash = hash * 31 + item;
             }
+            return hash;
         }
+    };
 
-        return result;
+    struct ChainEqual
+    {
+        bool operator()(const std::vector<CType> &a, const std::vector<CType> &b) const
+        {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(), sameType);
+        }
+    };
+
+    static const TypeNode *intern(const std::vector<CType> &chain)
+    {
+        // never freed, types live for the session
+        static std::unordered_map<std::vector<CType>, std::unique_ptr<TypeNode>, ChainHash, ChainEqual> table;
+        if (chain.empty())
+        {
+            return nullptr;
+        }
+        auto it = table.find(chain);
+        if (it != table.end())
+        {
+            return it->second.get();
+        }
+        auto node = std::make_unique<TypeNode>();
+        node->chain = chain;
+        node->inner = intern(std::vector<CType>(chain.begin() + 1, chain.end()));
+        return table.emplace(chain, std::move(node)).first->second.get();
+    }
+
+    TypeRef::TypeRef(std::initializer_list<CType> types)
+        : node(intern(std::vector<CType>(types)))
+    {
+    }
+
+    TypeRef::TypeRef(const std::vector<CType> &types)
+        : node(intern(types))
+    {
+    }
+
+    TypeRef TypeRef::of(CType::Type type)
+    {
+        static std::array<const TypeNode *, static_cast<size_t>(CType::Type::UNKNOWN) + 1> plain{};
+        const TypeNode *&slot = plain[static_cast<size_t>(type)];
+        if (!slot)
+        {
+            slot = intern({CType(type)});
+        }
+        return TypeRef(slot);
+    }
+
+    size_t TypeRef::size() const
+    {
+        return node ? node->chain.size() : 0;
+    }
+
+    const CType &TypeRef::operator[](size_t level) const
+    {
+        return node->chain[level];
+    }
+
+    const CType *TypeRef::begin() const
+    {
+        return node ? node->chain.data() : nullptr;
+    }
+
+    const CType *TypeRef::end() const
+    {
+        return node ? node->chain.data() + node->chain.size() : nullptr;
+    }
+
+    TypeRef TypeRef::inner() const
+    {
+        return TypeRef(node ? node->inner : nullptr);
+    }
+
+    TypeRef TypeRef::pointerTo(AddressSpace space) const
+    {
+        if (node)
+        {
+            for (const auto &link : node->pointers)
+            {
+                if (link.first == space)
+                {
+                    return TypeRef(link.second);
+                }
+            }
+        }
+        std::vector<CType> chain;
+        chain.reserve(size() + 1);
+        chain.push_back(CType::Type::POINTER);
+        chain[0].space = space;
+        chain.insert(chain.end(), begin(), end());
+        const TypeNode *pointer = intern(chain);
+        if (node)
+        {
+            node->pointers.emplace_back(space, pointer);
+        }
+        return TypeRef(pointer);
+    }
+
+    TypeRef TypeRef::withOuter(const CType &type) const
+    {
+        if (node && sameType(node->chain[0], type))
+        {
+            return *this;
+        }
+        if (size() <= 1 && type.name.empty() && type.space == AddressSpace::UNDEFINED && type.size == 0 && type.offset == 0 &&
+            !type.layout)
+        {
+            return of(type.type);
+        }
+        std::vector<CType> chain(begin(), end());
+        if (chain.empty())
+        {
+            chain.push_back(type);
+        }
+        else
+        {
+            chain[0] = type;
+        }
+        return TypeRef(intern(chain));
+    }
+
+    static std::string buildTypeName(const TypeRef &cType, bool isSigned);
+
+    const std::string &TypeRef::name(bool isSigned) const
+    {
+        static const std::string unknown = "<unknown type>";
+        if (!node)
+        {
+            return unknown;
+        }
+        std::string &name = node->names[isSigned ? 1 : 0];
+        if (name.empty())
+        {
+            name = buildTypeName(*this, isSigned);
+        }
+        return name;
+    }
+
+    size_t TypeRef::byteSize(DbgData &data) const
+    {
+        if (!node)
+        {
+            return 0;
+        }
+        if (node->sizeGeneration != data.model.generation())
+        {
+            const CType &top = node->chain[0];
+            node->byteSize = top == CType::Type::ARRAY ? top.size * inner().byteSize(data) : data.sizeOf(top);
+            node->sizeGeneration = data.model.generation();
+        }
+        return node->byteSize;
+    }
+
+    void StructLayout::add(Member member)
+    {
+        index[member.name] = members_.size();
+        members_.push_back(std::move(member));
+    }
+
+    const Member *StructLayout::find(const std::string &name) const
+    {
+        auto it = index.find(name);
+        return it != index.end() ? &members_[it->second] : nullptr;
+    }
+
+    CastType CastType::resolve(const std::string &typeName, DbgData *data)
+    {
+        CastType cast;
+        cast.name = typeName;
+        bool isUnsigned = false;
+        cast.cType = CType::parseCTypeVector(typeName, isUnsigned);
+        if (cast.cType.empty())
+            throw std::runtime_error("Invalid cast type: " + typeName);
+        cast.isSigned = !isUnsigned;
+
+        if (cast.cType[0] == CType::Type::POINTER)
+        {
+            cast.conversion = Conversion::POINTER;
+            return cast;
+        }
+        switch (cast.cType[0].type)
+        {
+        case CType::Type::CHAR:
+        case CType::Type::SHORT:
+        case CType::Type::INT:
+        case CType::Type::LONG:
+        case CType::Type::LONGLONG:
+            cast.conversion = Conversion::INTEGER;
+            cast.size = data ? data->sizeOf(cast.cType[0]) : 0;
+            break;
+        case CType::Type::FLOAT:
+            cast.conversion = Conversion::FLOAT;
+            break;
+        case CType::Type::DOUBLE:
+            cast.conversion = Conversion::DOUBLE;
+            break;
+        case CType::Type::BOOL:
+            cast.conversion = Conversion::BOOL;
+            cast.isSigned = false;
+            break;
+        default:
+            throw std::runtime_error("Unsupported cast to type: " + typeName);
+        }
+        return cast;
     }
 
     SymbolDescriptor::SymbolDescriptor(const char* s)
@@ -110,20 +651,33 @@ namespace CdbgExpr
         fromUint(u);
     }
 
+    SymbolDescriptor::SymbolDescriptor(const NumericLiteral& lit)
+    {
+        fromLiteral(lit);
+    }
+
+    SymbolDescriptor::SymbolDescriptor(const Value& val)
+        : value(val.bits), isSigned(val.isSigned), cType(val.type)
+    {
+    }
+
     std::variant<uint64_t, int64_t, double, float> SymbolDescriptor::getRealValue(const std::vector<uint64_t> &offset) const
     {
-        auto val = getConstLiteral(offset);
+        Value val = scalar(offset);
         std::variant<uint64_t, int64_t, double, float> result;
-        switch (val.cType.back().type)
+        switch (val.type.back().type)
         {
         case CType::Type::DOUBLE:
-            result = value_to_double_b(val.getValue());
+            result = value_to_double_b(val.bits);
             break;
         case CType::Type::FLOAT:
-            result = value_to_double_b(val.getValue());
+            result = value_to_float_b(val.bits);
             break;
         default:
-            result = isSigned ? (int64_t)val.getValue() : val.getValue();
+            if (isSigned)
+                result = (int64_t)val.bits;
+            else
+                result = val.bits;
             break;
         }
         return result;
@@ -198,17 +752,14 @@ namespace CdbgExpr
         return val;
     }
 
-    size_t SymbolDescriptor::getItemSize(const std::vector<CType> &cType, uint8_t level)
+    size_t SymbolDescriptor::getItemSize(const TypeRef &cType, uint8_t level)
     {
-        if (cType.size() <= level)
+        TypeRef type = cType;
+        for (uint8_t i = 0; i < level; i++)
         {
-            return 0;
-        }
-        if (cType[level] == CType::Type::ARRAY)
-        {
-            return cType[level].size * getItemSize(cType, level + 1);
+            type = type.inner();
         }
-        return data->CTypeSize(cType[level]);
+        return type.byteSize(*data);
     }
 
     CType SymbolDescriptor::promoteType(const CType &left, const CType &right)
@@ -226,19 +777,18 @@ namespace CdbgExpr
         {
             return CType::Type::POINTER;
         }
-        return (data->CTypeSize(left) > data->CTypeSize(right)) ? left : right;
+        return (data->sizeOf(left) > data->sizeOf(right)) ? left : right;
     }
     
     void SymbolDescriptor::fromString(const std::string &str)
     {
         std::string s = str;
-        cType.clear();
         hasAddress = false;
         isSigned = false;
     
         if (s.empty())
         {
-            cType.push_back(CType::Type::INT);
+            cType = TypeRef::of(CType::Type::INT);
             value = (int64_t)0;
             return;
         }
@@ -246,119 +796,153 @@ namespace CdbgExpr
         // Handle boolean literals
         if (s == "true")
         {
-            cType.push_back(CType::Type::BOOL);
+            cType = TypeRef::of(CType::Type::BOOL);
             value = (int64_t)1;
             return;
         }
         else if (s == "false")
         {
-            cType.push_back(CType::Type::BOOL);
+            cType = TypeRef::of(CType::Type::BOOL);
             value = (int64_t)0;
             return;
         }
     
-        // Handle integer suffixes (u, l, ul, ull, etc)
-        std::regex intRegex(R"(^[-+]?0[xX][0-9a-fA-F]+([uU]?[lL]{0,2}|[lL]{1,2}[uU]?)?$|^[-+]?0[bB][01]+([uU]?[lL]{0,2}|[lL]{1,2}[uU]?)?$|^[-+]?[0-9]+([uU]?[lL]{0,2}|[lL]{1,2}[uU]?)?$)");
-        if (std::regex_match(s, intRegex))
+        NumericLiteral lit;
+        if (decodeLiteral(s, lit))
         {
-            // Strip suffixes
-            std::string digits = s;
-            std::string suffix;
-    
-            // Find where suffix starts
-            size_t suffixStart = s.find_last_of("0123456789xXbBabcdefABCDEF");
-            if (suffixStart != std::string::npos && suffixStart + 1 < s.size())
-            {
-                suffix = s.substr(suffixStart + 1);
-                digits = s.substr(0, suffixStart + 1);
-            }
-    
-            // Determine base
-            int base = 10;
-            if (digits.find("0x") == 0 || digits.find("0X") == 0) base = 16;
-            else if (digits.find("0b") == 0 || digits.find("0B") == 0) {
-                base = 2;
-                // strtoull doesn't support binary, so manual parsing
-                uint64_t bin = 0;
-                size_t i = (digits[0] == '-') ? 3 : 2; // skip "0b" or "-0b"
-                for (; i < digits.size(); ++i) {
-                    if (digits[i] != '0' && digits[i] != '1')
-                        throw std::runtime_error("Invalid binary literal: " + s);
-                    bin = (bin << 1) | (digits[i] - '0');
-                }
-                if (digits[0] == '-') {
-                    isSigned = true;
-                    bin = uint64_t(-(int64_t(bin)));
-                }
-                cType.push_back(CType::Type::LONGLONG); // customize if needed
-                value = bin;
-                return;
-            } else if (digits[0] == '0' && digits.size() > 1 && digits[1] != 'x' && digits[1] != 'X') base = 8;
-    
-            // Parse the number
-            char* endptr = nullptr;
-            uint64_t parsed = std::strtoull(digits.c_str(), &endptr, base);
-    
-            // Determine signedness and size
-            std::string lowered;
-            for (char ch : suffix)
-                lowered += std::tolower(ch);
-    
-            if (lowered.find('u') != std::string::npos)
-                isSigned = false;
-            else
-                isSigned = true;
-    
-            if (lowered.find("ll") != std::string::npos)
-                cType.push_back(CType::Type::LONGLONG);
-            else if (lowered.find('l') != std::string::npos)
-                cType.push_back(CType::Type::LONG);
-            else
-                cType.push_back(CType::Type::INT);
-    
-            if (isSigned)
-                value = int64_t(parsed);
-            else
-                value = parsed;
-    
+            fromLiteral(lit);
             return;
         }
     
-        // Handle float literals with suffixes (f, l, etc)
-        std::regex floatRegex(R"(^[-+]?(\d+(\.\d*)?|\.\d+)([eE][-+]?\d+)?[fFlL]?$)");
-        if (std::regex_match(s, floatRegex))
+        // Fallback: treat as INT 0
+        cType = TypeRef::of(CType::Type::INT);
+        value = int64_t(0);
+    }
+
+    bool SymbolDescriptor::decodeLiteral(std::string_view str, NumericLiteral &lit)
+    {
+        bool negative = false;
+        if (!str.empty() && (str[0] == '-' || str[0] == '+'))
+        {
+            negative = str[0] == '-';
+            str.remove_prefix(1);
+        }
+        if (str.empty())
+        {
+            return false;
+        }
+
+        const char *end = str.data() + str.size();
+        bool isHex = str.size() > 1 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X');
+        bool isBin = str.size() > 1 && str[0] == '0' && (str[1] == 'b' || str[1] == 'B');
+
+        // Float literals with suffixes (f, l)
+        if (!isHex && !isBin && str.find_first_of(".eE") != std::string_view::npos)
         {
-            char* endptr;
-            double d = std::strtod(s.c_str(), &endptr);
-            if (endptr && (*endptr == 'f' || *endptr == 'F'))
+            double d = 0;
+            auto [ptr, ec] = std::from_chars(str.data(), end, d);
+            if (ec != std::errc() || end - ptr > 1)
             {
-                cType.push_back(CType::Type::FLOAT);
-                value = static_cast<float>(d);
+                return false;
+            }
+            if (negative)
+            {
+                d = -d;
+            }
+            lit.isSigned = false;
+            if (ptr != end && (*ptr == 'f' || *ptr == 'F'))
+            {
+                lit.type = CType::Type::FLOAT;
+                lit.value = std::bit_cast<uint32_t>(static_cast<float>(d));
+            }
+            else if (ptr == end || *ptr == 'l' || *ptr == 'L')
+            {
+                lit.type = CType::Type::DOUBLE;
+                lit.value = std::bit_cast<uint64_t>(d);
             }
             else
             {
-                cType.push_back(CType::Type::DOUBLE);
-                value = d;
+                return false;
             }
-            return;
+            return true;
         }
-    
-        // Fallback: treat as INT 0
-        cType.push_back(CType::Type::INT);
-        value = int64_t(0);
-    }    
+
+        // Integer literals: hex, binary, octal or decimal
+        int base = 10;
+        size_t prefix = 0;
+        if (isHex)
+        {
+            base = 16;
+            prefix = 2;
+        }
+        else if (isBin)
+        {
+            base = 2;
+            prefix = 2;
+        }
+        else if (str[0] == '0' && str.size() > 1 && std::isdigit(static_cast<unsigned char>(str[1])))
+        {
+            base = 8;
+            prefix = 1;
+        }
+
+        uint64_t parsed = 0;
+        auto [ptr, ec] = std::from_chars(str.data() + prefix, end, parsed, base);
+        if (ec != std::errc())
+        {
+            return false;
+        }
+
+        // Integer suffixes (u, l, ul, ull, lu, llu)
+        auto isU = [](char ch) { return ch == 'u' || ch == 'U'; };
+        auto isL = [](char ch) { return ch == 'l' || ch == 'L'; };
+        bool hasU = false;
+        int longs = 0;
+        if (ptr != end && isU(*ptr))
+        {
+            hasU = true;
+            ptr++;
+        }
+        while (ptr != end && isL(*ptr) && longs < 2)
+        {
+            longs++;
+            ptr++;
+        }
+        if (!hasU && ptr != end && isU(*ptr))
+        {
+            hasU = true;
+            ptr++;
+        }
+        if (ptr != end)
+        {
+            return false;
+        }
+
+        lit.isSigned = !hasU;
+        lit.type = longs == 2 ? CType::Type::LONGLONG : (longs == 1 ? CType::Type::LONG : CType::Type::INT);
+        lit.value = negative ? uint64_t(-int64_t(parsed)) : parsed;
+        return true;
+    }
+
+    void SymbolDescriptor::fromLiteral(const NumericLiteral &lit)
+    {
+        cType = TypeRef::of(lit.type);
+        hasAddress = false;
+        isSigned = lit.isSigned;
+        value = lit.value;
+    }
 
     void SymbolDescriptor::fromDouble(const double &val)
     {
         hasAddress = false;
-        cType.push_back(CType::Type::DOUBLE);
-        value = val;
+        cType = TypeRef::of(CType::Type::DOUBLE);
+        value = std::bit_cast<uint64_t>(val);
     }
 
     void SymbolDescriptor::fromInt(const int64_t &val)
     {
         hasAddress = false;
-        cType.push_back(CType::Type::LONGLONG);
+        cType = TypeRef::of(CType::Type::LONGLONG);
         value = val;
         isSigned = true;
     }
@@ -366,10 +950,18 @@ namespace CdbgExpr
     void SymbolDescriptor::fromUint(const uint64_t &val)
     {
         hasAddress = false;
-        cType.push_back(CType::Type::LONGLONG);
+        cType = TypeRef::of(CType::Type::LONGLONG);
         value = val;
     }
 
+    void SymbolDescriptor::fromBool(bool val)
+    {
+        hasAddress = false;
+        isSigned = false;
+        cType = TypeRef::of(CType::Type::BOOL);
+        value = val ? 1 : 0;
+    }
+
     SymbolDescriptor SymbolDescriptor::dereference(int offset) const
     {
         if (!data)
@@ -391,14 +983,14 @@ namespace CdbgExpr
                 throw std::runtime_error("Pointer type has no pointee");
 
             // Read the actual pointer value from memory
-            uint64_t pointedAddr = getValue();
+            uint64_t pointedAddr = pointerTarget(top, getValue(), result.space);
 
-            result.cType.erase(result.cType.begin()); // Remove POINTER layer
+            result.cType = cType.inner(); // Remove POINTER layer
             result.hasAddress = false;
             result.stack = false;
             result.regs.clear();
             
-            size_t size = getItemSize(result.cType);
+            size_t size = cType.stride(*data);
             result.size = size;
 
             result.setAddr(pointedAddr + offset * size);
@@ -409,13 +1001,14 @@ namespace CdbgExpr
                 throw std::runtime_error("Array type has no element type");
 
             uint64_t pointedAddr = getValue();
+            result.space = space; // elements live where the array does
 
-            result.cType.erase(result.cType.begin()); // Remove ARRAY layer
+            result.cType = cType.inner(); // Remove ARRAY layer
             result.hasAddress = false;
             result.stack = false;
             result.regs.clear();
             
-            size_t size = getItemSize(result.cType);
+            size_t size = cType.stride(*data);
             result.size = size;
 
             if (cType[1] == CType::Type::ARRAY)
@@ -436,14 +1029,64 @@ namespace CdbgExpr
         return result;
     }
 
+    // Layout of an aggregate type, from the type or else from the backend.
+    static std::shared_ptr<const StructLayout> layoutOf(const CType &type)
+    {
+        if (type.layout || SymbolDescriptor::data == nullptr || type.name.empty())
+        {
+            return type.layout;
+        }
+        return SymbolDescriptor::data->getLayout(type.name);
+    }
+
     SymbolDescriptor SymbolDescriptor::getMember(const std::string &name) const
     {
-        auto it = members.find(name);
-        if (it == members.end())
+        if (cType.empty() || (cType[0] != CType::Type::STRUCT && cType[0] != CType::Type::UNION))
+        {
+            throw std::runtime_error("Member access on a non-struct type");
+        }
+        std::shared_ptr<const StructLayout> layout = layoutOf(cType[0]);
+        const Member *member = layout ? layout->find(name) : nullptr;
+        if (member == nullptr)
         {
             throw std::runtime_error("Member not found");
         }
-        return (it->second.symbol);
+
+        // the member lives inside the aggregate, wherever that is
+        SymbolDescriptor result;
+        result.name = name;
+        result.cType = member->cType;
+        result.isSigned = member->isSigned;
+        result.space = space;
+        result.size = getItemSize(result.cType);
+        if (!regs.empty())
+        {
+            if (member->offset + result.size > regs.size())
+            {
+                throw std::runtime_error("Member outside of the registers of the struct");
+            }
+            result.regs.assign(regs.begin() + member->offset, regs.begin() + member->offset + result.size);
+            result.value = 0;
+        }
+        else if (stack)
+        {
+            result.stack = true;
+            result.stackOffs = stackOffs + member->offset;
+            result.value = 0;
+        }
+        else if (hasAddress)
+        {
+            result.setAddr(value + member->offset);
+            if (result.cType[0] == CType::Type::ARRAY)
+            {
+                result.hasAddress = false; // arrays are values holding their base address
+            }
+        }
+        else
+        {
+            throw std::runtime_error("Struct value has no location");
+        }
+        return result;
     }
 
     SymbolDescriptor SymbolDescriptor::addressOf() const
@@ -462,8 +1105,7 @@ namespace CdbgExpr
             addr = value;
         }
         SymbolDescriptor result;
-        result.cType = cType;
-        result.cType.insert(result.cType.begin(), CType::Type::POINTER);
+        result.cType = cType.pointerTo(space);
         result.value = addr;
         result.hasAddress = false;
         result.size = getItemSize(result.cType);
@@ -486,10 +1128,13 @@ namespace CdbgExpr
         }
         if (regs.size())
         {
-            for (uint64_t i = 0; i < regs.size() && i < 8; i++)
+            size_t count = std::min<size_t>(regs.size(), 8);
+            uint8_t bytes[8];
+            for (size_t i = 0; i < count; i++)
             {
-                data->setRegContent(regs[i], ((val >> (i * 8)) & 0xFF));
+                bytes[i] = (val >> (i * 8)) & 0xFF;
             }
+            data->writeRegisters(std::span<const uint8_t>(regs.data(), count), std::span<const uint8_t>(bytes, count));
         }
         if (hasAddress || stack)
         {
@@ -500,7 +1145,7 @@ namespace CdbgExpr
             uint64_t addr = value;
             if (stack)
             {
-                addr = data->getStackPointer() + stackOffs;
+                addr = data->frame().frameBase + stackOffs;
             }
             setValueAt(addr, val);
         }
@@ -520,7 +1165,7 @@ namespace CdbgExpr
         {
             for (uint64_t i = 0; i < regs.size() && i < 8; i++)
             {
-                val |= (uint64_t)data->getRegContent(regs[i]) << (i * 8);
+                val |= (uint64_t)data->readRegister(regs[i]) << (i * 8);
             }
         }
         else if (hasAddress || stack)
@@ -532,7 +1177,7 @@ namespace CdbgExpr
             uint64_t addr = value;
             if (stack)
             {
-                addr = data->getStackPointer() + stackOffs;
+                addr = data->frame().frameBase + stackOffs;
             }
             val = getValueAt(addr);
         }
@@ -542,32 +1187,31 @@ namespace CdbgExpr
         }
         return val;
     }
+
+    Value SymbolDescriptor::rvalue() const
+    {
+        return {getValue(), cType, isSigned};
+    }
     void SymbolDescriptor::setValueAt(uint64_t addr, uint64_t val, uint8_t level)
     {
         if (level >= cType.size()) throw std::out_of_range("Invalid cType level");
-        for (uint64_t i = 0; i < data->CTypeSize(cType[level]); i++)
-        {
-            data->setByte(addr + i, ((val >> (i * 8)) & 0xFF));
-        }
+        ValueCodec codec = data->model.codec(*data, cType[level]);
+        uint8_t bytes[8];
+        codec.encode(val, bytes);
+        data->writeMemory(space, addr, std::span<const uint8_t>(bytes, codec.width));
     }
     uint64_t SymbolDescriptor::getValueAt(uint64_t addr, uint8_t level) const
     {
         if (level >= cType.size()) throw std::out_of_range("Invalid cType level");
 
-        uint64_t val = 0;
-        for (uint64_t i = 0; i < data->CTypeSize(cType[level]); i++)
-        {
-            val |= (uint64_t)data->getByte(addr + i) << (i * 8);
-        }
-        return val;
+        ValueCodec codec = data->model.codec(*data, cType[level]);
+        uint8_t bytes[8];
+        data->readMemory(space, addr, std::span<uint8_t>(bytes, codec.width));
+        return codec.decode(bytes);
     }
 
-    std::string SymbolDescriptor::typeOf() const
+    static std::string buildTypeName(const TypeRef &cType, bool isSigned)
     {
-        if (data == nullptr)
-        {
-            throw std::runtime_error("DbgData pointer is null");
-        }
         if (cType.size() <= 0)
             return "<unknown type>";
         std::ostringstream result;
@@ -661,6 +1305,17 @@ namespace CdbgExpr
         return result.str();
     }
 
+    std::string SymbolDescriptor::typeOf() const
+    {
+        if (data == nullptr)
+        {
+            throw std::runtime_error("DbgData pointer is null");
+        }
+        return cType.name(isSigned);
+    }
+
+    static constexpr size_t STRING_CHUNK = 16;
+
     std::string SymbolDescriptor::toString() const
     {
         if (data == nullptr)
@@ -679,20 +1334,52 @@ namespace CdbgExpr
 
             if (cType[1] == CType::Type::CHAR)
             {
-                if (!getValue())
+                uint64_t pointer = getValue();
+                if (!pointer)
                 {
                     return "0x0";
                 }
                 else
                 {
-                    result << "0x" << std::hex << getValue();
+                    result << "0x" << std::hex << pointer;
                 }
                 result << " \"";
-                uint64_t addr = getValue();
-                char ch;
-                while ((ch = static_cast<char>(data->getByte(addr++))) != '\0')
+                // read the string in chunks, one transaction each. Chunks end at
+                // multiples of STRING_CHUNK, so they stay inside the space; SFR
+                // reads can have side effects and go a byte at a time.
+                AddressSpace stringSpace;
+                uint64_t addr = pointerTarget(cType[0], pointer, stringSpace);
+                size_t chunkSize = (stringSpace == AddressSpace::SFR || stringSpace == AddressSpace::SBIT) ? 1 : STRING_CHUNK;
+                uint8_t chunk[STRING_CHUNK];
+                bool done = false;
+                while (!done)
                 {
-                    result << ch;
+                    std::span<uint8_t> bytes(chunk, chunkSize - addr % chunkSize);
+                    try
+                    {
+                        data->readMemory(stringSpace, addr, bytes);
+                    }
+                    catch (const std::exception &)
+                    {
+                        if (bytes.size() == 1)
+                        {
+                            throw;
+                        }
+                        // the target rejected part of the chunk, go on a byte at a time
+                        chunkSize = 1;
+                        bytes = bytes.first(1);
+                        data->readMemory(stringSpace, addr, bytes);
+                    }
+                    addr += bytes.size();
+                    for (uint8_t ch : bytes)
+                    {
+                        if (ch == '\0')
+                        {
+                            done = true;
+                            break;
+                        }
+                        result << static_cast<char>(ch);
+                    }
                 }
                 result << "\"";
                 return result.str();
@@ -708,10 +1395,27 @@ namespace CdbgExpr
         {
             if (cType.size() < 2)
                 return "<unknown type>[]";
+            // scalar elements are read with a single transaction for the whole array
+            bool scalarItems = cType.size() == 2 && cType[1] != CType::Type::STRUCT &&
+                               cType[1] != CType::Type::UNION && cType[1] != CType::Type::ARRAY;
+            ValueCodec itemCodec = scalarItems ? data->model.codec(*data, cType[1]) : ValueCodec();
+            size_t itemSize = itemCodec.size;
+            std::vector<uint8_t> bytes;
+            if (itemSize > 0 && itemSize <= 8)
+            {
+                bytes.resize(cType[0].size * itemSize);
+                data->readMemory(space, getValue(), bytes);
+            }
             result << "[";
             for (size_t i = 0; i < cType[0].size; i++)
             {
-                result << dereference(i).toString();
+                SymbolDescriptor item = dereference(i);
+                if (!bytes.empty())
+                {
+                    item.hasAddress = false;
+                    item.value = itemCodec.decode(&bytes[i * itemSize]);
+                }
+                result << item.toString();
                 if (i != cType[0].size - 1)
                 {
                     result << ", ";
@@ -724,11 +1428,14 @@ namespace CdbgExpr
         {
             result << cType[0].name;
             result << "{";
-            for (auto& member : members)
+            if (std::shared_ptr<const StructLayout> layout = layoutOf(cType[0]))
             {
-                result << member.first << " = ";
-                result << member.second.symbol.toString();
-                result << ", ";
+                for (const Member &member : layout->members())
+                {
+                    result << member.name << " = ";
+                    result << getMember(member.name).toString();
+                    result << ", ";
+                }
             }
             result << "}";
             return result.str();
@@ -752,77 +1459,126 @@ namespace CdbgExpr
         return *this;
     }
 
+    static bool isIndexable(const TypeRef &cType)
+    {
+        return !cType.empty() && (cType[0] == CType::Type::ARRAY || cType[0] == CType::Type::POINTER);
+    }
+
     SymbolDescriptor SymbolDescriptor::getConstLiteral(const std::vector<uint64_t>& offset) const
     {
-        SymbolDescriptor result = *this;
-        for (size_t i = 0; i < offset.size() && result.cType.size() && 
-            (result.cType[0] == CType::Type::ARRAY || result.cType[0] == CType::Type::POINTER); i++)
+        if (offset.empty() || !isIndexable(cType))
+        {
+            return *this;
+        }
+        SymbolDescriptor result = dereference(offset[0]);
+        for (size_t i = 1; i < offset.size() && isIndexable(result.cType); i++)
         {
             result = result.dereference(offset[i]);
         }
         return result;
     }
 
+    Value SymbolDescriptor::scalar(const std::vector<uint64_t>& offset) const
+    {
+        if (offset.empty() || !isIndexable(cType))
+        {
+            return rvalue();
+        }
+        return getConstLiteral(offset).rvalue();
+    }
+
     float SymbolDescriptor::toFloat(const std::vector<uint64_t>& offset) const
     {
-        uint64_t addr = getConstLiteral(offset).getValue();
-        
-        return value_to_float_n(getValueAt(addr, cType.size() - 1), cType.back(), isSigned);
+        return scalar(offset).toFloat();
     }
 
     double SymbolDescriptor::toDouble(const std::vector<uint64_t>& offset) const
     {
-        uint64_t addr = getConstLiteral(offset).getValue();
-
-        return value_to_double_n(getValueAt(addr, cType.size() - 1), cType.back(), isSigned);
+        return scalar(offset).toDouble();
     }
 
     uint64_t SymbolDescriptor::toUnsigned(const std::vector<uint64_t>& offset) const
     {
-        uint64_t addr = getConstLiteral(offset).getValue();
-
-        return value_to_uint64_n(getValueAt(addr, cType.size() - 1), cType.back());
+        return scalar(offset).toUnsigned();
     }
 
     int64_t SymbolDescriptor::toSigned(const std::vector<uint64_t>& offset) const
     {
-        uint64_t addr = getConstLiteral(offset).getValue();
+        return scalar(offset).toSigned();
+    }
+
+    bool SymbolDescriptor::toBool(const std::vector<uint64_t>& offset) const
+    {
+        return scalar(offset).toBool();
+    }
+
+    const CType &Value::outer() const
+    {
+        static const CType untyped;
+        return type.empty() ? untyped : type[0];
+    }
+
+    float Value::toFloat() const
+    {
+        return SymbolDescriptor::value_to_float_n(bits, outer(), isSigned);
+    }
+
+    double Value::toDouble() const
+    {
+        return SymbolDescriptor::value_to_double_n(bits, outer(), isSigned);
+    }
+
+    uint64_t Value::toUnsigned() const
+    {
+        return SymbolDescriptor::value_to_uint64_n(bits, outer());
+    }
+
+    int64_t Value::toSigned() const
+    {
+        return SymbolDescriptor::value_to_int64_n(bits, outer());
+    }
 
-        return value_to_int64_n(getValueAt(addr, cType.size() - 1), cType.back());
+    bool Value::toBool() const
+    {
+        const CType &type = outer();
+        if (type == CType::Type::FLOAT || type == CType::Type::DOUBLE)
+        {
+            return SymbolDescriptor::value_to_double_n(bits, type) != 0;
+        }
+        return bits != 0;
     }
 
     template <typename Op>
-    SymbolDescriptor SymbolDescriptor::applyArithmetic(const SymbolDescriptor &right, Op op) const
+    Value SymbolDescriptor::applyArithmetic(const Value &left, const Value &right, Op op)
     {
-        SymbolDescriptor result;
-        result.cType = cType;
-        result.isSigned = (isSigned || right.isSigned);
-        result.hasAddress = false;
-        if (!cType.empty() && !right.cType.empty())
+        Value result;
+        result.type = left.type;
+        result.isSigned = (left.isSigned || right.isSigned);
+        if (!left.type.empty() && !right.type.empty())
         {
-            result.cType[0] = promoteType(cType[0], right.cType[0]);
+            result.type = left.type.withOuter(promoteType(left.type[0], right.type[0]));
         }
-        else
+        else if (left.type.empty())
         {
-            result.cType.push_back(CType::Type::UNKNOWN);
+            result.type = TypeRef::of(CType::Type::UNKNOWN);
         }
-        switch (result.cType[0].type)
+        switch (result.type[0].type)
         {
         case CType::Type::FLOAT:
-            result.value = static_cast<double>(op(toFloat(), right.toFloat()));
+            result.bits = std::bit_cast<uint32_t>(static_cast<float>(op(left.toFloat(), right.toFloat())));
             break;
         case CType::Type::DOUBLE:
-            result.value = static_cast<double>(op(toDouble(), right.toDouble()));
+            result.bits = std::bit_cast<uint64_t>(static_cast<double>(op(left.toDouble(), right.toDouble())));
             break;
         default:
             {
                 if (result.isSigned)
                 {
-                    result.value = (int64_t)op(isSigned ? toSigned() : toUnsigned(), right.isSigned ? right.toSigned() : right.toUnsigned());
+                    result.bits = (uint64_t)(int64_t)op(left.toSigned(), right.toSigned());
                 }
                 else
                 {
-                    result.value = (uint64_t)op(isSigned ? toSigned() : toUnsigned(), right.isSigned ? right.toSigned() : right.toUnsigned());
+                    result.bits = (uint64_t)op(left.toUnsigned(), right.toUnsigned());
                 }
             }
             break;
@@ -831,203 +1587,231 @@ namespace CdbgExpr
     }
 
     template <typename Op>
-    SymbolDescriptor SymbolDescriptor::applyComparison(const SymbolDescriptor &right, Op op) const
+    Value SymbolDescriptor::applyComparison(const Value &left, const Value &right, Op op)
     {
-        SymbolDescriptor result;
-        result.cType = cType;
+        Value result;
         result.isSigned = false;
-        result.hasAddress = false;
-        result.cType.clear();
-        result.cType.push_back(CType::Type::BOOL);
-        if (cType.empty())
+        result.type = TypeRef::of(CType::Type::BOOL);
+        if (left.type.empty())
         {
             return result;
         }
-        switch (cType[0].type)
+        switch (left.type[0].type)
         {
         case CType::Type::FLOAT:
-            result.value = static_cast<uint64_t>(op(toFloat(), right.toFloat()));
+            result.bits = static_cast<uint64_t>(op(left.toFloat(), right.toFloat()));
             break;
         case CType::Type::DOUBLE:
-            result.value = static_cast<uint64_t>(op(toDouble(), right.toDouble()));
+            result.bits = static_cast<uint64_t>(op(left.toDouble(), right.toDouble()));
             break;
         default:
-            result.value = static_cast<uint64_t>(isSigned ? op(toSigned(), right.toSigned()) : (op(toUnsigned(), right.toUnsigned())));
+            result.bits = static_cast<uint64_t>(left.isSigned ? op(left.toSigned(), right.toSigned()) : (op(left.toUnsigned(), right.toUnsigned())));
             break;
         }
         return result;
     }
 
     template <typename Op>
-    SymbolDescriptor SymbolDescriptor::applyLogical(const SymbolDescriptor &right, Op op) const
+    Value SymbolDescriptor::applyLogical(const Value &left, const Value &right, Op op)
     {
-        SymbolDescriptor result;
+        Value result;
         result.isSigned = false;
-        result.hasAddress = false;
-        result.cType.clear();
-        result.cType.push_back(CType::Type::BOOL);
-        if (cType.empty())
+        result.type = TypeRef::of(CType::Type::BOOL);
+        if (left.type.empty())
         {
             return result;
         }
-        switch (cType[0].type)
+        switch (left.type[0].type)
         {
         case CType::Type::FLOAT:
-            result.value = static_cast<uint64_t>(op(toFloat(), right.toFloat()));
+            result.bits = static_cast<uint64_t>(op(left.toFloat(), right.toFloat()));
             break;
         case CType::Type::DOUBLE:
-            result.value = static_cast<uint64_t>(op(toDouble(), right.toDouble()));
+            result.bits = static_cast<uint64_t>(op(left.toDouble(), right.toDouble()));
             break;
         default:
-            result.value = static_cast<uint64_t>(op(toUnsigned(), right.toUnsigned()));
+            result.bits = static_cast<uint64_t>(op(left.toUnsigned(), right.toUnsigned()));
             break;
         }
         return result;
     }
 
     template <typename Op>
-    SymbolDescriptor SymbolDescriptor::applyBitwise(const SymbolDescriptor &right, Op op) const
+    Value SymbolDescriptor::applyBitwise(const Value &left, const Value &right, Op op)
     {
-        SymbolDescriptor result;
-        result.cType = cType;
-        if (!cType.empty() && !right.cType.empty())
+        Value result;
+        result.type = left.type;
+        if (!left.type.empty() && !right.type.empty())
         {
-            result.cType[0] = promoteType(cType[0], right.cType[0]);
+            result.type = left.type.withOuter(promoteType(left.type[0], right.type[0]));
         }
-        else
+        else if (left.type.empty())
         {
-            result.cType.push_back(CType::Type::UNKNOWN);
+            result.type = TypeRef::of(CType::Type::UNKNOWN);
         }
-        result.isSigned = (isSigned || right.isSigned);
-        result.hasAddress = false;
-        result.value = op(toUnsigned(), right.toUnsigned());
+        result.isSigned = (left.isSigned || right.isSigned);
+        result.bits = op(left.toUnsigned(), right.toUnsigned());
         return result;
     }
 
+    SymbolDescriptor SymbolDescriptor::applyIdentity(const SymbolDescriptor &right, bool keepRight, bool bitwise) const
+    {
+        auto keepA = [](auto a, auto) { return a; };
+        auto keepB = [](auto, auto b) { return b; };
+        Value l = rvalue(), r = right.rvalue();
+        if (bitwise)
+        {
+            return SymbolDescriptor(keepRight ? applyBitwise(l, r, keepB) : applyBitwise(l, r, keepA));
+        }
+        return SymbolDescriptor(keepRight ? applyArithmetic(l, r, keepB) : applyArithmetic(l, r, keepA));
+    }
+
     SymbolDescriptor SymbolDescriptor::operator+(const SymbolDescriptor &right) const
     {
-        return applyArithmetic(right, std::plus<>());
+        return SymbolDescriptor(applyArithmetic(rvalue(), right.rvalue(), std::plus<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator-(const SymbolDescriptor &right) const
     {
-        return applyArithmetic(right, std::minus<>());
+        return SymbolDescriptor(applyArithmetic(rvalue(), right.rvalue(), std::minus<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator-() const
     {
-        return applyArithmetic(*this, [](auto a, auto)
-                               { return -a; });
+        Value val = rvalue();
+        return SymbolDescriptor(applyArithmetic(val, val, [](auto a, auto)
+                                                { return -a; }));
     }
 
     SymbolDescriptor SymbolDescriptor::operator*(const SymbolDescriptor &right) const
     {
-        return applyArithmetic(right, std::multiplies<>());
+        return SymbolDescriptor(applyArithmetic(rvalue(), right.rvalue(), std::multiplies<>()));
+    }
+
+    static bool isFloating(const TypeRef &cType)
+    {
+        return !cType.empty() && (cType[0] == CType::Type::FLOAT || cType[0] == CType::Type::DOUBLE);
     }
 
     SymbolDescriptor SymbolDescriptor::operator/(const SymbolDescriptor &right) const
     {
-        return applyArithmetic(right, std::divides<>());
+        Value l = rvalue(), r = right.rvalue();
+        if (!isFloating(l.type) && !isFloating(r.type) && r.toUnsigned() == 0)
+        {
+            throw std::runtime_error("Division by zero");
+        }
+        if (!isFloating(l.type) && !isFloating(r.type) && (l.isSigned || r.isSigned) && r.toSigned() == -1)
+        {
+            // Negate in unsigned arithmetic, INT64_MIN / -1 traps
+            return SymbolDescriptor(applyArithmetic(l, r, [](auto a, auto) { return decltype(a)(0 - (uint64_t)a); }));
+        }
+        return SymbolDescriptor(applyArithmetic(l, r, std::divides<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator%(const SymbolDescriptor &right) const
     {
-        SymbolDescriptor result;
-        result.cType.push_back(CType::Type::INT);
-        result.isSigned = isSigned;
-        result.value = getValue();
-        result.value = result.toUnsigned() % right.toUnsigned();
-        result.hasAddress = false;
-        return result;
+        Value result{getValue(), TypeRef::of(CType::Type::INT), isSigned};
+        uint64_t divisor = right.rvalue().toUnsigned();
+        if (divisor == 0)
+        {
+            throw std::runtime_error("Division by zero");
+        }
+        if (isSigned)
+        {
+            int64_t signedDivisor = right.rvalue().toSigned();
+            result.bits = signedDivisor == -1 ? 0 : (uint64_t)(result.toSigned() % signedDivisor);
+        }
+        else
+        {
+            result.bits = result.toUnsigned() % divisor;
+        }
+        return SymbolDescriptor(result);
     }
 
     SymbolDescriptor SymbolDescriptor::operator==(const SymbolDescriptor &right) const
     {
-        return applyComparison(right, std::equal_to<>());
+        return SymbolDescriptor(applyComparison(rvalue(), right.rvalue(), std::equal_to<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator!=(const SymbolDescriptor &right) const
     {
-        return applyComparison(right, std::not_equal_to<>());
+        return SymbolDescriptor(applyComparison(rvalue(), right.rvalue(), std::not_equal_to<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator<(const SymbolDescriptor &right) const
     {
-        return applyComparison(right, std::less<>());
+        return SymbolDescriptor(applyComparison(rvalue(), right.rvalue(), std::less<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator>(const SymbolDescriptor &right) const
     {
-        return applyComparison(right, std::greater<>());
+        return SymbolDescriptor(applyComparison(rvalue(), right.rvalue(), std::greater<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator<=(const SymbolDescriptor &right) const
     {
-        return applyComparison(right, std::less_equal<>());
+        return SymbolDescriptor(applyComparison(rvalue(), right.rvalue(), std::less_equal<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator>=(const SymbolDescriptor &right) const
     {
-        return applyComparison(right, std::greater_equal<>());
+        return SymbolDescriptor(applyComparison(rvalue(), right.rvalue(), std::greater_equal<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator&&(const SymbolDescriptor &right) const
     {
-        return applyLogical(right, std::logical_and<>());
+        return SymbolDescriptor(applyLogical(rvalue(), right.rvalue(), std::logical_and<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator||(const SymbolDescriptor &right) const
     {
-        return applyLogical(right, std::logical_or<>());
+        return SymbolDescriptor(applyLogical(rvalue(), right.rvalue(), std::logical_or<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator!() const
     {
-        return applyLogical(*this, [](auto a, auto)
-                            { return !a; });
+        Value val = rvalue();
+        return SymbolDescriptor(applyLogical(val, val, [](auto a, auto)
+                                             { return !a; }));
     }
 
     SymbolDescriptor SymbolDescriptor::operator&(const SymbolDescriptor &right) const
     {
-        return applyBitwise(right, std::bit_and<>());
+        return SymbolDescriptor(applyBitwise(rvalue(), right.rvalue(), std::bit_and<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator|(const SymbolDescriptor &right) const
     {
-        return applyBitwise(right, std::bit_or<>());
+        return SymbolDescriptor(applyBitwise(rvalue(), right.rvalue(), std::bit_or<>()));
     }
 
     SymbolDescriptor SymbolDescriptor::operator^(const SymbolDescriptor &right) const
     {
-        return applyBitwise(right, std::bit_xor<>());
+        return SymbolDescriptor(applyBitwise(rvalue(), right.rvalue(), std::bit_xor<>()));
+    }
+
+    // Type of a unary or shift result: the outermost type of the operand.
+    static TypeRef unaryType(const TypeRef &cType)
+    {
+        return cType.empty() ? TypeRef::of(CType::Type::INT) : TypeRef().withOuter(cType[0]);
     }
 
     SymbolDescriptor SymbolDescriptor::operator~() const
     {
-        SymbolDescriptor result;
-        result.isSigned = isSigned;
-        result.hasAddress = false;
-        result.value = ~toUnsigned();
-        return result;
+        return SymbolDescriptor(Value{~rvalue().toUnsigned(), unaryType(cType), isSigned});
     }
 
     SymbolDescriptor SymbolDescriptor::operator<<(const SymbolDescriptor &right) const
     {
-        SymbolDescriptor result;
-        result.isSigned = isSigned;
-        result.value = getValue();
-        result.value = result.toUnsigned() << right.toUnsigned();
-        result.hasAddress = false;
-        return result;
+        return SymbolDescriptor(Value{rvalue().toUnsigned() << right.rvalue().toUnsigned(), unaryType(cType), isSigned});
     }
 
     SymbolDescriptor SymbolDescriptor::operator>>(const SymbolDescriptor &right) const
     {
-        SymbolDescriptor result;
-        result.isSigned = isSigned;
-        result.value = getValue();
-        result.value = result.toUnsigned() >> right.toUnsigned();
-        result.hasAddress = false;
-        return result;
+        Value val = rvalue();
+        uint64_t shift = right.rvalue().toUnsigned();
+        // Arithmetic shift for signed operands
+        val.bits = isSigned ? (uint64_t)(val.toSigned() >> shift) : val.toUnsigned() >> shift;
+        return SymbolDescriptor(Value{val.bits, unaryType(cType), isSigned});
     }
 } // namespace CdbgExpr
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "CachedDbgData.h"
+#include "TestTarget.h"
+#include "Check.h"
+
+using namespace CdbgExpr;
+
+int main()
+{
+    // pdata pointers (DP) and generic pointers tagged 0x60 refer to the same space
+    CHECK(pointerSpaceFromCode("DP") == AddressSpace::EXTERNAL_STACK);
+    CHECK(pointerSpaceFromCode("DX") == AddressSpace::EXTERNAL_RAM);
+
+    SimulatedTarget target;
+    const uint8_t pdataPointer[] = {0x30, 0xAA};          // one byte, the next is not part of it
+    const uint8_t genericPointer[] = {0x30, 0x00, 0x60}; // pdata 0x30
+    const uint8_t value = 42;
+    addSymbol(target, "pp", pointerTo(pointerSpaceFromCode("DP"), CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x10, pdataPointer);
+    addSymbol(target, "gp", pointerTo(pointerSpaceFromCode("DG"), CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x20, genericPointer);
+    target.load(AddressSpace::EXTERNAL_STACK, 0x30, std::span<const uint8_t>(&value, 1));
+
+    CHECK_EQ(int(target.sizeOf(eval(target, "pp").cType[0])), 1);
+    CHECK_NOTHROW(CHECK_EQ(eval(target, "pp").toUnsigned(), 0x30u));
+    CHECK_NOTHROW(CHECK_EQ(eval(target, "*pp").toUnsigned(), 42u));
+    CHECK_NOTHROW(CHECK_EQ(eval(target, "*gp").toUnsigned(), 42u));
+
+    // both are cached under the same page
+    CachedDbgData cache(&target);
+    CHECK_NOTHROW(eval(cache, "pp"));
+    CHECK_NOTHROW(eval(cache, "gp"));
+    CHECK_NOTHROW(eval(cache, "*pp").toUnsigned());
+    target.resetStats();
+    CHECK_NOTHROW(CHECK_EQ(eval(cache, "*gp").toUnsigned(), 42u));
+    CHECK_EQ(target.stats().readCalls, 0u);
+
+    return checkResult();
+}
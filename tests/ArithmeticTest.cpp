@@ -0,0 +1,39 @@
+#include "TestTarget.h"
+#include "Check.h"
+
+#include <climits>
+
+using namespace CdbgExpr;
+
+static int64_t evalSigned(DbgData &data, const std::string &expr)
+{
+    return eval(data, expr).toSigned();
+}
+
+int main()
+{
+    SimulatedTarget target;
+    const uint8_t minusNine[] = {0xF7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    addSymbol(target, "n", TypeRef::of(CType::Type::LONGLONG), AddressSpace::EXTERNAL_RAM, 0x10, minusNine, true);
+
+    // signed operands divide and shift as signed
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "-5 / 2"), -2));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "7 / -2"), -3));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "-5 % 2"), -1));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "-8 >> 1"), -4));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "-1 >> 4"), -1));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "n / 2"), -4));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "n >> 1"), -5));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "n * -3"), 27));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "(n - 1) / 2 * 2"), -10));
+
+    // unsigned operands are unaffected
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "16u >> 2"), 4));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "7u / 2u"), 3));
+
+    // the one signed quotient that overflows wraps instead of trapping
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "(-9223372036854775807ll - 1) / -1"), LLONG_MIN));
+    CHECK_NOTHROW(CHECK_EQ(evalSigned(target, "(-9223372036854775807ll - 1) % -1"), 0));
+
+    return checkResult();
+}
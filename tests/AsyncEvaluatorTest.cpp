@@ -0,0 +1,40 @@
+#include "TestTarget.h"
+#include "Check.h"
+
+using namespace CdbgExpr;
+
+int main()
+{
+    SimulatedTarget target;
+    const uint8_t initial = 5;
+    addSymbol(target, "x", TypeRef::of(CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x100, std::span<const uint8_t>(&initial, 1));
+
+    SyncDbgDataAdapter adapter(&target);
+    AsyncEvaluator evaluator(&adapter);
+
+    // a display only evaluation does not write, also not while fetching
+    SymbolDescriptor::assignmentAllowed = false;
+    bool threw = false;
+    try
+    {
+        eval(evaluator, "x = 7", false);
+    }
+    catch (const std::exception &)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK_EQ(int(byteAt(target, AddressSpace::EXTERNAL_RAM, 0x100)), 5);
+    CHECK(!SymbolDescriptor::assignmentAllowed);
+
+    CHECK_NOTHROW(CHECK_EQ(eval(evaluator, "(x = 7) + 1", true).toUnsigned(), 8u));
+    CHECK_EQ(int(byteAt(target, AddressSpace::EXTERNAL_RAM, 0x100)), 7);
+
+    // every node is settled once: both operands of the sum go out together
+    target.resetStats();
+    evaluator.invalidate();
+    CHECK_NOTHROW(CHECK_EQ(eval(evaluator, "x + x * 2", false).toUnsigned(), 21u));
+    CHECK_EQ(target.stats().readCalls, 1u);
+
+    return checkResult();
+}
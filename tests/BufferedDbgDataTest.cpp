@@ -0,0 +1,68 @@
+#include "BufferedDbgData.h"
+#include "TestTarget.h"
+#include "Check.h"
+#include <stdexcept>
+
+using namespace CdbgExpr;
+
+int main()
+{
+    SimulatedTarget target;
+    const uint8_t zeros[2] = {};
+    addSymbol(target, "a", TypeRef::of(CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x10, zeros);
+    addSymbol(target, "b", TypeRef::of(CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x11, zeros);
+    addSymbol(target, "i", TypeRef::of(CType::Type::INT), AddressSpace::EXTERNAL_RAM, 0x12, zeros);
+    addSymbol(target, "far", TypeRef::of(CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x40, zeros);
+    addSymbol(target, "p1", TypeRef::of(CType::Type::CHAR), AddressSpace::SFR, 0x90);
+    BufferedDbgData buffer(&target);
+
+    // adjacent writes go out as one range, and reads see them before that
+    {
+        WriteBatch batch(buffer);
+        CHECK_NOTHROW(eval(buffer, "i = 0x1234, b = 2, a = 1", true));
+        CHECK_EQ(target.stats().writeCalls, 0u);
+        CHECK_EQ(buffer.pendingRanges(), 1u);
+        CHECK_EQ(buffer.pendingBytes(), 4u);
+        target.resetStats();
+        CHECK_NOTHROW(CHECK_EQ(eval(buffer, "a + b + i").toUnsigned(), 0x1237u));
+        CHECK_EQ(target.stats().readCalls, 0u);
+        batch.commit();
+    }
+    CHECK_EQ(target.stats().writeCalls, 1u);
+    CHECK_EQ(target.stats().bytesWritten, 4u);
+    CHECK_EQ(int(byteAt(target, AddressSpace::EXTERNAL_RAM, 0x10)), 1);
+    CHECK_EQ(int(byteAt(target, AddressSpace::EXTERNAL_RAM, 0x13)), 0x12);
+
+    // a range apart is written on its own, SFRs are written right away
+    target.resetStats();
+    {
+        WriteBatch batch(buffer);
+        CHECK_NOTHROW(eval(buffer, "a = 3, far = 4, p1 = 5", true));
+        CHECK_EQ(target.stats().writeCalls, 1u);
+        CHECK_EQ(int(byteAt(target, AddressSpace::SFR, 0x90)), 5);
+        batch.commit();
+    }
+    CHECK_EQ(target.stats().writeCalls, 3u);
+    CHECK_EQ(target.stats().bytesWritten, 3u);
+    CHECK_EQ(buffer.flushedRanges(), 3u);
+
+    // a batch left by an exception discards or flushes, as chosen
+    target.resetStats();
+    for (bool discardOnError : {true, false})
+    {
+        try
+        {
+            WriteBatch batch(buffer, discardOnError);
+            eval(buffer, "a = 9", true);
+            throw std::runtime_error("interrupted");
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+        CHECK_EQ(int(byteAt(target, AddressSpace::EXTERNAL_RAM, 0x10)), discardOnError ? 3 : 9);
+        CHECK_EQ(buffer.pendingRanges(), 0u);
+    }
+    CHECK_EQ(target.stats().writeCalls, 1u);
+
+    return checkResult();
+}
@@ -0,0 +1,57 @@
+#include "CachedDbgData.h"
+#include "TestTarget.h"
+#include "Check.h"
+
+using namespace CdbgExpr;
+
+static uint8_t readByte(CachedDbgData &cache, AddressSpace space, uint64_t addr)
+{
+    uint8_t val = 0;
+    cache.readMemory(space, addr, std::span<uint8_t>(&val, 1));
+    return val;
+}
+
+static bool readFails(CachedDbgData &cache, AddressSpace space, uint64_t addr)
+{
+    try
+    {
+        readByte(cache, space, addr);
+    }
+    catch (const std::exception &)
+    {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    FailingTarget target;
+    const uint8_t x = 42, k = 7;
+    addSymbol(target, "x", TypeRef::of(CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x10, std::span<const uint8_t>(&x, 1));
+    target.load(AddressSpace::CODE, 0x20, std::span<const uint8_t>(&k, 1));
+    CachedDbgData cache(&target);
+
+    // a failed read leaves no page behind, neither per stop nor for the session
+    target.failReads = 1;
+    CHECK(readFails(cache, AddressSpace::EXTERNAL_RAM, 0x10));
+    CHECK_NOTHROW(CHECK_EQ(int(readByte(cache, AddressSpace::EXTERNAL_RAM, 0x10)), 42));
+    target.failReads = 1;
+    CHECK(readFails(cache, AddressSpace::CODE, 0x20));
+    CHECK_NOTHROW(CHECK_EQ(int(readByte(cache, AddressSpace::CODE, 0x20)), 7));
+    target.failReads = 1;
+    cache.invalidate();
+    CHECK(readFails(cache, AddressSpace::EXTERNAL_RAM, 0x11));
+    CHECK_NOTHROW(CHECK_EQ(int(readByte(cache, AddressSpace::EXTERNAL_RAM, 0x10)), 42));
+
+    // pages are served from the cache until invalidate(), writes go through
+    target.resetStats();
+    CHECK_NOTHROW(CHECK_EQ(eval(cache, "x").toUnsigned(), 42u));
+    CHECK_NOTHROW(CHECK_EQ(eval(cache, "x = 5", true).toUnsigned(), 5u));
+    CHECK_NOTHROW(CHECK_EQ(eval(cache, "x").toUnsigned(), 5u));
+    CHECK_EQ(target.stats().readCalls, 0u);
+    CHECK_EQ(target.stats().writeCalls, 1u);
+    CHECK_EQ(int(byteAt(target, AddressSpace::EXTERNAL_RAM, 0x10)), 5);
+
+    return checkResult();
+}
@@ -0,0 +1,53 @@
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <iostream>
+
+// Minimal checks for the tests: failures are reported and counted, and main
+// returns checkResult() as the exit status.
+inline int checkFailures = 0;
+
+#define CHECK(cond)                                                                       \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(cond))                                                                      \
+        {                                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n";    \
+            checkFailures++;                                                              \
+        }                                                                                 \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                        \
+    do                                                                                    \
+    {                                                                                     \
+        auto actualValue = (actual);                                                      \
+        auto expectedValue = (expected);                                                  \
+        if (!(actualValue == expectedValue))                                              \
+        {                                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is " << actualValue \
+                      << ", expected " << expectedValue << "\n";                          \
+            checkFailures++;                                                              \
+        }                                                                                 \
+    } while (0)
+
+// Evaluates expr, reporting an exception as a failure.
+#define CHECK_NOTHROW(expr)                                                               \
+    do                                                                                    \
+    {                                                                                     \
+        try                                                                               \
+        {                                                                                 \
+            expr;                                                                         \
+        }                                                                                 \
+        catch (const std::exception &e)                                                   \
+        {                                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #expr " threw " << e.what() << "\n"; \
+            checkFailures++;                                                              \
+        }                                                                                 \
+    } while (0)
+
+inline int checkResult()
+{
+    return checkFailures == 0 ? 0 : 1;
+}
+
+#endif // _CHECK_H_
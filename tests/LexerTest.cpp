@@ -0,0 +1,35 @@
+#include "TestTarget.h"
+#include "Check.h"
+#include <cmath>
+#include <string>
+
+using namespace CdbgExpr;
+
+static bool rejected(const std::string &expr)
+{
+    try
+    {
+        tokenize(expr);
+    }
+    catch (const std::exception &)
+    {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    // literals that do not decode are an error, not zero
+    CHECK(rejected("99999999999999999999"));
+    CHECK(rejected("1.5e999"));
+    CHECK(rejected("0x"));
+
+    SimulatedTarget target;
+    CHECK_NOTHROW(CHECK_EQ(eval(target, "18446744073709551615u").toUnsigned(), 18446744073709551615u));
+    CHECK_NOTHROW(CHECK_EQ(eval(target, "0x1F + 010 + 0b11").toUnsigned(), 42u));
+    CHECK_NOTHROW(CHECK_EQ(eval(target, "1.5e3").toDouble(), 1500.0));
+    CHECK_NOTHROW(CHECK(std::isinf(eval(target, "1e308 * 10").toDouble())));
+
+    return checkResult();
+}
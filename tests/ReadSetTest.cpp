@@ -0,0 +1,47 @@
+#include "CachedDbgData.h"
+#include "TestTarget.h"
+#include "Check.h"
+
+using namespace CdbgExpr;
+
+int main()
+{
+    FailingTarget target;
+    const uint8_t z = 42;
+    addSymbol(target, "z", TypeRef::of(CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x10, std::span<const uint8_t>(&z, 1));
+    addSymbol(target, "g", TypeRef::of(CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x20);
+    // outside the 256 bytes of idata, any read of it fails
+    SymbolDescriptor f;
+    f.name = "f";
+    f.cType = {CType::Type::CHAR};
+    f.space = AddressSpace::INTERNAL_RAM;
+    f.setAddr(0x180);
+    target.addSymbol(f);
+    CachedDbgData cache(&target);
+
+    // operands that may be skipped are not read up front
+    {
+        CompiledExpression logical("z == 0 && f", &cache);
+        CHECK_EQ(logical.readSet().size(), 1u);
+        CHECK_NOTHROW(CHECK_EQ(logical.eval(false).toUnsigned(), 0u));
+        CompiledExpression conditional("z ? g : f", &cache);
+        CHECK_EQ(conditional.readSet().size(), 1u);
+        CHECK_NOTHROW(CHECK_EQ(conditional.eval(false).toUnsigned(), 0u));
+    }
+
+    // the set follows the symbols of the current scope
+    {
+        CompiledExpression expr("g", &cache);
+        CHECK(!expr.readSet().empty() && expr.readSet()[0].addr == 0x20);
+        addSymbol(target, "g", TypeRef::of(CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, 0x80, std::span<const uint8_t>(&z, 1));
+        CHECK(!expr.readSet().empty() && expr.readSet()[0].addr == 0x80);
+        CHECK_NOTHROW(CHECK_EQ(expr.eval(false).toUnsigned(), 42u));
+    }
+
+    // a failed prefetch is only a missed hint
+    cache.invalidate();
+    target.failReads = 1;
+    CHECK_NOTHROW(CHECK_EQ(eval(cache, "z").toUnsigned(), 42u));
+
+    return checkResult();
+}
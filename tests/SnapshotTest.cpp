@@ -0,0 +1,62 @@
+#include "CachedDbgData.h"
+#include "TestTarget.h"
+#include "Check.h"
+
+using namespace CdbgExpr;
+
+static void setR0(SimulatedTarget &target, uint8_t val)
+{
+    target.load(AddressSpace::INTERNAL_RAM, 0x00, std::span<const uint8_t>(&val, 1)); // bank 0
+}
+
+int main()
+{
+    SimulatedTarget target;
+    SymbolDescriptor r;
+    r.name = "r";
+    r.cType = {CType::Type::CHAR};
+    r.isSigned = true;
+    r.regs = {0};
+    target.addSymbol(r);
+
+    // a plain backend sees registers change between evaluations
+    setR0(target, 1);
+    CHECK_EQ(eval(target, "r").toSigned(), 1);
+    setR0(target, 2);
+    CHECK_EQ(eval(target, "r").toSigned(), 2);
+
+    // a cache keeps them for the stop, until invalidate()
+    CachedDbgData cache(&target);
+    CHECK_EQ(eval(cache, "r").toSigned(), 2);
+    setR0(target, 3);
+    CHECK_EQ(eval(cache, "r").toSigned(), 2);
+    cache.invalidate();
+    CHECK_EQ(eval(cache, "r").toSigned(), 3);
+
+    // stack locals follow the stack pointer between evaluations
+    SymbolDescriptor l;
+    l.name = "l";
+    l.cType = {CType::Type::CHAR};
+    l.isSigned = true;
+    l.stack = true;
+    l.stackOffs = -2;
+    l.space = AddressSpace::INTERNAL_STACK;
+    target.addSymbol(l);
+    const uint8_t first = 11, second = 22, outer = 33;
+    target.load(AddressSpace::INTERNAL_STACK, 0x40 - 2, std::span<const uint8_t>(&first, 1));
+    target.load(AddressSpace::INTERNAL_STACK, 0x50 - 2, std::span<const uint8_t>(&second, 1));
+    target.load(AddressSpace::INTERNAL_STACK, 0x60 - 2, std::span<const uint8_t>(&outer, 1));
+    target.setStackPointer(0x40);
+    CHECK_EQ(eval(target, "l").toSigned(), 11);
+    target.setStackPointer(0x50);
+    CHECK_EQ(eval(target, "l").toSigned(), 22);
+
+    // a selected frame stays until invalidateFrame()
+    target.selectFrame(FrameContext{0x60, 0x60, 1});
+    CHECK_EQ(eval(target, "l").toSigned(), 33);
+    CHECK_EQ(eval(target, "l").toSigned(), 33);
+    target.invalidateFrame();
+    CHECK_EQ(eval(target, "l").toSigned(), 22);
+
+    return checkResult();
+}
@@ -0,0 +1,43 @@
+#include "TestTarget.h"
+#include "Check.h"
+#include <cstring>
+#include <string>
+
+using namespace CdbgExpr;
+
+// char * in space, stored at xdata addr and pointing to to.
+static void addStringPointer(SimulatedTarget &target, const std::string &name, uint64_t addr, AddressSpace space, uint16_t to)
+{
+    const uint8_t bytes[2] = {static_cast<uint8_t>(to & 0xFF), static_cast<uint8_t>(to >> 8)};
+    addSymbol(target, name, pointerTo(space, CType::Type::CHAR), AddressSpace::EXTERNAL_RAM, addr, bytes);
+}
+
+static void loadString(SimulatedTarget &target, AddressSpace space, uint64_t addr, const char *str)
+{
+    target.load(space, addr, std::span<const uint8_t>(reinterpret_cast<const uint8_t *>(str), std::strlen(str) + 1));
+}
+
+int main()
+{
+    SimulatedTarget target;
+
+    // strings ending right at the top of xdata and idata
+    addStringPointer(target, "xstr", 0x10, AddressSpace::EXTERNAL_RAM, 0xFFFA);
+    loadString(target, AddressSpace::EXTERNAL_RAM, 0xFFFA, "hello");
+    addStringPointer(target, "istr", 0x20, AddressSpace::INTERNAL_RAM, 0xF8);
+    loadString(target, AddressSpace::INTERNAL_RAM, 0xF8, "abcdefg");
+    CHECK_NOTHROW(CHECK_EQ(eval(target, "xstr").toString(), std::string("0xfffa \"hello\"")));
+    CHECK_NOTHROW(CHECK_EQ(eval(target, "istr").toString(), std::string("0xf8 \"abcdefg\"")));
+
+    // a string spanning chunks
+    addStringPointer(target, "lstr", 0x30, AddressSpace::EXTERNAL_RAM, 0x1009);
+    loadString(target, AddressSpace::EXTERNAL_RAM, 0x1009, "a string longer than one chunk");
+    CHECK_NOTHROW(CHECK_EQ(eval(target, "lstr").toString(), std::string("0x1009 \"a string longer than one chunk\"")));
+
+    // no reads past the chunk holding the terminator
+    target.resetStats();
+    CHECK_NOTHROW(eval(target, "xstr").toString());
+    CHECK(target.stats().bytesRead <= 2 + 6);
+
+    return checkResult();
+}
@@ -0,0 +1,44 @@
+#include "BufferedDbgData.h"
+#include "CachedDbgData.h"
+#include "TestTarget.h"
+#include "Check.h"
+
+using namespace CdbgExpr;
+
+int main()
+{
+    SimulatedTarget target;
+    target.model.byteOrder = ByteOrder::BIG;
+    CachedDbgData cache(&target);
+    CType dimension(CType::Type::ARRAY);
+    dimension.size = 4;
+    TypeRef array{dimension, CType::Type::INT};
+
+    // wrappers, and wrappers of wrappers, use the layout of the target
+    CHECK(cache.model.byteOrder == ByteOrder::BIG);
+    CHECK_EQ(cache.model.generation(), target.model.generation());
+    CHECK_EQ(array.byteSize(target), 4u * target.sizeOf(CType::Type::INT));
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        BufferedDbgData staged(&cache);
+        CHECK_EQ(staged.model.generation(), target.model.generation());
+        CHECK_EQ(array.byteSize(staged), array.byteSize(target));
+    }
+
+    // so does an evaluator over a synchronous target, and its staged writes
+    SyncDbgDataAdapter adapter(&cache);
+    AsyncEvaluator evaluator(&adapter);
+    CHECK(evaluator.model.byteOrder == ByteOrder::BIG);
+    CHECK_EQ(evaluator.model.generation(), target.model.generation());
+    BufferedDbgData staged(&evaluator);
+    CHECK_EQ(staged.model.generation(), target.model.generation());
+    CHECK_EQ(array.byteSize(evaluator), array.byteSize(target));
+
+    // reset through a wrapper is seen by all of them
+    uint64_t generation = target.model.generation();
+    cache.model.reset();
+    CHECK(target.model.generation() != generation);
+    CHECK_EQ(cache.model.generation(), target.model.generation());
+
+    return checkResult();
+}
@@ -0,0 +1,74 @@
+#ifndef _TEST_TARGET_H_
+#define _TEST_TARGET_H_
+
+#include <span>
+#include <stdexcept>
+#include <string>
+#include "AsyncEvaluator.h"
+#include "CdbgExpr.h"
+#include "SimulatedTarget.h"
+
+// Fixtures shared by the tests.
+
+// Fails the next failReads reads, as a probe link dropping a transaction.
+class FailingTarget : public CdbgExpr::SimulatedTarget
+{
+public:
+    int failReads = 0;
+
+    void readMemory(CdbgExpr::AddressSpace space, uint64_t addr, std::span<uint8_t> out) override
+    {
+        if (failReads > 0)
+        {
+            failReads--;
+            throw std::runtime_error("Read failed");
+        }
+        SimulatedTarget::readMemory(space, addr, out);
+    }
+};
+
+// Evaluates expr against data.
+inline CdbgExpr::SymbolDescriptor eval(CdbgExpr::DbgData &data, const std::string &expr, bool assignmentAllowed = false)
+{
+    return CdbgExpr::CompiledExpression(expr, &data).eval(assignmentAllowed);
+}
+
+// Evaluates expr through evaluator, for targets that complete every fetch
+// right away (eg. SyncDbgDataAdapter).
+inline CdbgExpr::SymbolDescriptor eval(CdbgExpr::AsyncEvaluator &evaluator, const std::string &expr, bool assignmentAllowed = false)
+{
+    CdbgExpr::CompiledExpression compiled(expr, &evaluator);
+    CdbgExpr::Task<CdbgExpr::SymbolDescriptor> task = evaluator.eval(compiled, assignmentAllowed);
+    task.start();
+    return task.result();
+}
+
+// Adds a symbol of type at addr in space, holding bytes.
+inline void addSymbol(CdbgExpr::SimulatedTarget &target, const std::string &name, const CdbgExpr::TypeRef &type,
+                      CdbgExpr::AddressSpace space, uint64_t addr, std::span<const uint8_t> bytes = {}, bool isSigned = false)
+{
+    CdbgExpr::SymbolDescriptor symbol;
+    symbol.name = name;
+    symbol.cType = type;
+    symbol.isSigned = isSigned;
+    symbol.space = space;
+    symbol.setAddr(addr);
+    target.addSymbol(symbol);
+    target.load(space, addr, bytes);
+}
+
+// Pointer into space to type.
+inline CdbgExpr::TypeRef pointerTo(CdbgExpr::AddressSpace space, CdbgExpr::CType::Type type)
+{
+    return CdbgExpr::TypeRef::of(type).pointerTo(space);
+}
+
+// One byte of target memory, read without a transaction.
+inline uint8_t byteAt(CdbgExpr::SimulatedTarget &target, CdbgExpr::AddressSpace space, uint64_t addr)
+{
+    uint8_t val;
+    target.dump(space, addr, std::span<uint8_t>(&val, 1));
+    return val;
+}
+
+#endif // _TEST_TARGET_H_